@@ -0,0 +1,470 @@
+/**
+ * Copyright (c) 2008 Christopher Allen Ogden
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef SYD_FRAMEWORK_ASYNCCONTROLLER_H_
+#define SYD_FRAMEWORK_ASYNCCONTROLLER_H_
+
+#include <coroutine>
+#include <exception>
+#include <cstddef>
+#include <new>
+#include "Controller.h"
+#include "ModelObserver.h"
+#include "Facade.h"
+
+namespace sydmvc {
+
+/**
+ * Pool for coroutine frames.  Frames are rounded up to a size class and
+ * recycled through per-class free lists, so routines that are started
+ * over and over do not go back to the heap.  Each thread has its own
+ * pool.
+ */
+class FramePool
+{
+    public:
+        /**
+         * Allocate a frame.
+         *
+         * @param size  Size of the frame.
+         * @return      Memory for the frame.
+         */
+        static void *allocate(std::size_t size)
+        {
+            std::size_t cls = sizeClass(size);
+            if (cls >= CLASSES) return ::operator new(size);
+            Block *&head = freeList(cls);
+            if (head) {
+                Block *block = head;
+                head = block->next;
+                return block;
+            }
+            return ::operator new((cls + 1) * GRANULE);
+        }
+
+        /**
+         * Release a frame.
+         *
+         * @param frame Frame to release.
+         * @param size  Size it was allocated with.
+         */
+        static void release(void *frame, std::size_t size)
+        {
+            std::size_t cls = sizeClass(size);
+            if (cls >= CLASSES) {
+                ::operator delete(frame);
+                return;
+            }
+            Block *block = static_cast<Block *>(frame);
+            block->next = freeList(cls);
+            freeList(cls) = block;
+        }
+
+    private:
+        enum { GRANULE = 64, CLASSES = 32 };
+
+        struct Block
+        {
+            Block *next;
+        };
+
+        static std::size_t sizeClass(std::size_t size)
+        {
+            return (size + GRANULE - 1) / GRANULE - 1;
+        }
+
+        static Block *&freeList(std::size_t cls)
+        {
+            static thread_local Block *lists[CLASSES];
+            return lists[cls];
+        }
+};
+
+/**
+ * Handle to a coroutine written as a routine of an AsyncController.  A
+ * routine can co_await another routine, which runs it to completion
+ * before carrying on.  Requires C++20.
+ */
+class Routine
+{
+    public:
+        class promise_type
+        {
+            public:
+                Routine get_return_object()
+                {
+                    return Routine(std::coroutine_handle<promise_type>::from_promise(*this));
+                }
+
+                std::suspend_always initial_suspend() noexcept
+                {
+                    return std::suspend_always();
+                }
+
+                struct FinalAwaiter
+                {
+                    bool await_ready() noexcept { return false; }
+                    void await_resume() noexcept {}
+                    std::coroutine_handle<> await_suspend(
+                            std::coroutine_handle<promise_type> handle) noexcept
+                    {
+                        std::coroutine_handle<> next = handle.promise()._continuation;
+                        return next ? next : std::noop_coroutine();
+                    }
+                };
+
+                FinalAwaiter final_suspend() noexcept
+                {
+                    return FinalAwaiter();
+                }
+
+                void return_void() {}
+
+                void unhandled_exception()
+                {
+                    std::terminate();
+                }
+
+                static void *operator new(std::size_t size)
+                {
+                    return FramePool::allocate(size);
+                }
+
+                static void operator delete(void *frame, std::size_t size)
+                {
+                    FramePool::release(frame, size);
+                }
+
+            private:
+                friend class Routine;
+                std::coroutine_handle<> _continuation;
+        };
+
+        Routine():_handle() {}
+
+        Routine(Routine &&other):_handle(other._handle)
+        {
+            other._handle = std::coroutine_handle<promise_type>();
+        }
+
+        Routine &operator=(Routine &&other)
+        {
+            if (this != &other) {
+                if (_handle) _handle.destroy();
+                _handle = other._handle;
+                other._handle = std::coroutine_handle<promise_type>();
+            }
+            return *this;
+        }
+
+        /**
+         * Destructor.  Destroys the coroutine, wherever it is suspended.
+         */
+        ~Routine()
+        {
+            if (_handle) _handle.destroy();
+        }
+
+        /**
+         * Check whether the routine has run to completion.
+         *
+         * @return  True if the routine is finished.
+         */
+        bool done() const
+        {
+            return !_handle || _handle.done();
+        }
+
+        /**
+         * Start the routine.  It runs until its first suspension.
+         */
+        void start()
+        {
+            if (_handle && !_handle.done()) _handle.resume();
+        }
+
+        bool await_ready() const { return done(); }
+        void await_resume() {}
+
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller)
+        {
+            _handle.promise()._continuation = caller;
+            return _handle;
+        }
+
+    private:
+        explicit Routine(std::coroutine_handle<promise_type> handle):_handle(handle) {}
+
+        std::coroutine_handle<promise_type> _handle;
+
+        Routine(const Routine &);
+        void operator=(const Routine &);
+};
+
+/**
+ * Async controllers describe multi-step interactions as a coroutine
+ * instead of a hand-written state machine.  The routine can wait for the
+ * next system event, for a timer, or for a model to notify.  Resumption is
+ * always scheduled on the facade's main loop, never done from inside a
+ * dispatch.  Waiting for system events and timers does not allocate.
+ * Waiting for a model subscribes to it the first time; the subscription
+ * is kept, so waiting again for the same model and event is free, while
+ * switching to another model or event subscribes anew.
+ *
+ * Only one wait is outstanding at a time.  Events arriving while the
+ * routine is busy or waiting for something else are ignored.  The events
+ * the routine waits for must be in getNotificationList().
+ */
+template <class I>
+class AsyncController: public Controller<I>
+{
+    public:
+        /**
+         * Attach to the system and start the routine.
+         */
+        virtual void attach()
+        {
+            Controller<I>::attach();
+            _routine = main();
+            _routine.start();
+        }
+
+        /**
+         * Called by the system.  Wakes the routine if it is waiting for
+         * the event.
+         *
+         * @param event Event type.
+         */
+        virtual void update(int event)
+        {
+            if (_waiting != WAIT_EVENT) return;
+            if (!_filter.empty()) {
+                typename System<I>::NotificationList::const_iterator iter = _filter.begin();
+                while (iter != _filter.end() && (*iter) != event) {
+                    iter++;
+                }
+                if (iter == _filter.end()) return;
+            }
+            wake(event);
+        }
+
+        /**
+         * Destructor.  Cancels any outstanding wait and destroys the
+         * routine.
+         */
+        virtual ~AsyncController()
+        {
+            if (_waiting == WAIT_TIMER) this->getFacade()->cancelTimer(_timer);
+            if (_resuming) this->getFacade()->cancelPosts(&_resumer);
+            forgetModel();
+        }
+
+        /**
+         * Awaitable returned by the wait functions.
+         */
+        class Awaiter
+        {
+            public:
+                bool await_ready() const { return false; }
+
+                void await_suspend(std::coroutine_handle<> handle)
+                {
+                    _controller->_handle = handle;
+                }
+
+                int await_resume() const
+                {
+                    return _controller->_event;
+                }
+
+            private:
+                friend class AsyncController;
+                explicit Awaiter(AsyncController * const controller):_controller(controller) {}
+                AsyncController *_controller;
+        };
+
+    protected:
+        AsyncController():_waiting(WAIT_NONE),_handle(),_event(0),_resuming(false),_model(NULL),
+                _modelEvent(0),_resumer(this),_modelWaiter(this) {}
+
+        /**
+         * The routine run by this controller.  It is started on attach()
+         * and usually loops for as long as the controller exists.
+         *
+         * @return  The routine.
+         */
+        virtual Routine main() = 0;
+
+        /**
+         * Wait for the next system event in the filter.
+         *
+         * @param filter    Events to wait for; empty means any.
+         * @return          Awaitable yielding the event.
+         */
+        Awaiter nextEvent(const typename System<I>::NotificationList &filter =
+                typename System<I>::NotificationList())
+        {
+            _filter = filter;
+            _waiting = WAIT_EVENT;
+            return Awaiter(this);
+        }
+
+        /**
+         * Wait for the next occurrence of a system event.
+         *
+         * @param event Event to wait for.
+         * @return      Awaitable yielding the event.
+         */
+        Awaiter nextEvent(int event)
+        {
+            _filter.assign(1, event);
+            _waiting = WAIT_EVENT;
+            return Awaiter(this);
+        }
+
+        /**
+         * Wait for some time to pass.
+         *
+         * @param delay Milliseconds to wait.
+         * @return      Awaitable.
+         */
+        Awaiter sleep(unsigned long delay)
+        {
+            _waiting = WAIT_TIMER;
+            _timer = this->getFacade()->setTimer(&_resumer, RESUME, delay);
+            return Awaiter(this);
+        }
+
+        /**
+         * Wait for a model to notify an event, such as the completion of
+         * an operation it is running.
+         *
+         * The controller stays subscribed to the model after the wait,
+         * until it waits for something else, forgetModel() is called, or
+         * it is destroyed.  The model must outlive the subscription.
+         *
+         * @param model Model to wait on.
+         * @param event Event to wait for.
+         * @return      Awaitable yielding the event.
+         */
+        Awaiter waitFor(Model * const model, int event)
+        {
+            if (model != _model || event != _modelEvent) {
+                forgetModel();
+                model->attach(&_modelWaiter, Model::NotificationList(1, event));
+                _model = model;
+                _modelEvent = event;
+            }
+            _waiting = WAIT_MODEL;
+            return Awaiter(this);
+        }
+
+        /**
+         * Drop the subscription kept by waitFor(), for instance before the
+         * model is destroyed.
+         */
+        void forgetModel()
+        {
+            if (_model) _model->detach(&_modelWaiter);
+            _model = NULL;
+        }
+
+    private:
+        enum Waiting { WAIT_NONE, WAIT_EVENT, WAIT_TIMER, WAIT_MODEL };
+        enum { RESUME = -1 };
+
+        /**
+         * Resumes the routine when updated from the main loop.
+         */
+        class Resumer: public Observer
+        {
+            public:
+                explicit Resumer(AsyncController * const controller):_controller(controller) {}
+                void update(int event)
+                {
+                    _controller->resume();
+                }
+
+            private:
+                AsyncController *_controller;
+        };
+
+        /**
+         * Observes the model being waited on.
+         */
+        class ModelWaiter: public ModelObserver
+        {
+            public:
+                explicit ModelWaiter(AsyncController * const controller):_controller(controller) {}
+                void update(int event)
+                {
+                    if (_controller->_waiting == WAIT_MODEL && event == _controller->_modelEvent) {
+                        _controller->wake(event);
+                    }
+                }
+
+            private:
+                AsyncController *_controller;
+        };
+
+        /**
+         * Record the event that ended the wait and schedule the routine to
+         * resume from the main loop.
+         */
+        void wake(int event)
+        {
+            _event = event;
+            _waiting = WAIT_NONE;
+            _resuming = true;
+            this->getFacade()->post(&_resumer, RESUME);
+        }
+
+        /**
+         * Resume the waiting routine.
+         */
+        void resume()
+        {
+            _resuming = false;
+            _waiting = WAIT_NONE;
+            std::coroutine_handle<> handle = _handle;
+            _handle = std::coroutine_handle<>();
+            if (handle) handle.resume();
+        }
+
+        Routine _routine;
+        Waiting _waiting;
+        std::coroutine_handle<> _handle;
+        int _event;
+        bool _resuming;
+        typename System<I>::NotificationList _filter;
+        TimerId _timer;
+        Model *_model;
+        int _modelEvent;
+        Resumer _resumer;
+        ModelWaiter _modelWaiter;
+
+        DISALLOW_COPY_AND_ASSIGN(AsyncController);
+};
+
+}
+
+#endif
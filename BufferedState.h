@@ -0,0 +1,204 @@
+/**
+ * Copyright (c) 2008 Christopher Allen Ogden
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef SYD_FRAMEWORK_BUFFEREDSTATE_H_
+#define SYD_FRAMEWORK_BUFFEREDSTATE_H_
+
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include "macros.h"
+
+namespace sydmvc {
+
+/**
+ * State that is written by the logic thread and read by the render thread.
+ * The facade publishes it at the end of every frame.
+ */
+class StateBuffer
+{
+    public:
+        /**
+         * Make what has been written so far visible to the reader.  Logic
+         * thread only.
+         */
+        virtual void publish() = 0;
+
+        /**
+         * Bring the state being written up to date after publishing.  Logic
+         * thread only; may run while the reader acquires.
+         */
+        virtual void refresh() {}
+
+        /**
+         * Switch the reader to the latest published state, if there is a
+         * newer one.  Render thread only.
+         */
+        virtual void acquire() = 0;
+
+        virtual ~StateBuffer() {}
+
+    protected:
+        StateBuffer() {}
+
+    private:
+        DISALLOW_COPY_AND_ASSIGN(StateBuffer);
+};
+
+/**
+ * Triple-buffered state.  The writer has a back buffer, the reader a front
+ * buffer, and the third holds the latest published state.  Publishing and
+ * acquiring each swap one buffer index atomically, so neither side ever
+ * waits for the other.  After publishing, refresh() brings the writer's new
+ * back buffer up to date by copying the published state into it; the
+ * reader only ever reads that state, so the copy needs no lock.
+ */
+template <class T>
+class BufferedState: public StateBuffer
+{
+    public:
+        /**
+         * Constructor.
+         *
+         * @param initial   Initial state of all three buffers.
+         */
+        explicit BufferedState(const T &initial = T()):_back(0),_published(0),_middle(1),_front(2)
+        {
+            for (unsigned int i = 0; i < 3; i++) {
+                _buffers[i] = initial;
+            }
+        }
+
+        /**
+         * Get the state being written.  Logic thread only.
+         *
+         * @return  Back buffer.
+         */
+        T &back()
+        {
+            return _buffers[_back];
+        }
+
+        /**
+         * Get the state being read.  Render thread only.
+         *
+         * @return  Front buffer.
+         */
+        const T &front() const
+        {
+            return _buffers[_front];
+        }
+
+        virtual void publish()
+        {
+            _published = _back;
+            _back = _middle.exchange(_published | FRESH, std::memory_order_acq_rel) & INDEX;
+        }
+
+        virtual void refresh()
+        {
+            _buffers[_back] = _buffers[_published];
+        }
+
+        virtual void acquire()
+        {
+            if ((_middle.load(std::memory_order_relaxed) & FRESH) == 0) return;
+            _front = _middle.exchange(_front, std::memory_order_acq_rel) & INDEX;
+        }
+
+    private:
+        enum { INDEX = 3, FRESH = 4 };
+
+        T _buffers[3];
+        unsigned int _back;
+        unsigned int _published;
+        std::atomic<unsigned int> _middle;
+        unsigned int _front;
+
+        DISALLOW_COPY_AND_ASSIGN(BufferedState);
+};
+
+/**
+ * The buffers published together at the end of a frame.  Publishing and
+ * acquiring the whole set is serialized by a lock that is only held for
+ * the index swaps, so the reader always sees every buffer from the same
+ * frame.  The back buffers are refreshed after the lock is released.
+ */
+class StateBufferSet
+{
+    public:
+        StateBufferSet() {}
+
+        /**
+         * Add a buffer.  Logic thread only, before rendering starts.
+         *
+         * @param buffer    Buffer to add; not owned.
+         */
+        void add(StateBuffer * const buffer)
+        {
+            _buffers.push_back(buffer);
+        }
+
+        /**
+         * Publish every buffer.
+         */
+        void publish()
+        {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                for (BufferList::iterator iter = _buffers.begin();
+                        iter != _buffers.end();
+                        iter++) {
+                    (*iter)->publish();
+                }
+            }
+            for (BufferList::iterator iter = _buffers.begin();
+                    iter != _buffers.end();
+                    iter++) {
+                (*iter)->refresh();
+            }
+        }
+
+        /**
+         * Acquire every buffer.
+         */
+        void acquire()
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            for (BufferList::iterator iter = _buffers.begin();
+                    iter != _buffers.end();
+                    iter++) {
+                (*iter)->acquire();
+            }
+        }
+
+    private:
+        typedef std::vector<StateBuffer *> BufferList;
+        BufferList _buffers;
+        std::mutex _mutex;
+
+        DISALLOW_COPY_AND_ASSIGN(StateBufferSet);
+};
+
+}
+
+#endif
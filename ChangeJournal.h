@@ -0,0 +1,207 @@
+/**
+ * Copyright (c) 2008 Christopher Allen Ogden
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef SYD_FRAMEWORK_CHANGEJOURNAL_H_
+#define SYD_FRAMEWORK_CHANGEJOURNAL_H_
+
+#include <vector>
+#include <map>
+
+namespace sydmvc {
+
+/**
+ * A change to a range of elements, or to a property, of a model.
+ */
+class Change
+{
+    public:
+        enum Kind {
+            INSERTED,
+            REMOVED,
+            UPDATED,
+            PROPERTY
+        };
+
+        Change(Kind k, unsigned int f, unsigned int c, unsigned long v)
+            :kind(k),first(f),count(c),version(v) {}
+
+        /**
+         * What happened.
+         */
+        Kind kind;
+
+        /**
+         * First element affected, or the property for PROPERTY changes.
+         */
+        unsigned int first;
+
+        /**
+         * Number of elements affected.
+         */
+        unsigned int count;
+
+        /**
+         * Version the change produced.
+         */
+        unsigned long version;
+};
+
+typedef std::vector<Change> ChangeList;
+
+/**
+ * Records the changes made to a model as a bounded journal of versioned
+ * entries, along with the version at which each property last changed.
+ * Observers remember the version they have seen and later ask for what
+ * changed since, instead of comparing the whole model.
+ */
+class ChangeJournal
+{
+    public:
+        /**
+         * Constructor.
+         *
+         * @param capacity  Number of entries kept before the oldest are
+         *                  forgotten.
+         */
+        explicit ChangeJournal(unsigned int capacity = 256)
+            :_version(0),_forgotten(0),_head(0),_capacity(capacity)
+        {
+        }
+
+        /**
+         * Get the current version.
+         *
+         * @return  Version of the latest change, or 0 if none.
+         */
+        unsigned long getVersion() const
+        {
+            return _version;
+        }
+
+        /**
+         * Get the version at which a property last changed.
+         *
+         * @param property  Property to look up.
+         * @return          Version, or 0 if it never changed.
+         */
+        unsigned long getVersion(int property) const
+        {
+            std::map<int, unsigned long>::const_iterator iter = _properties.find(property);
+            return iter == _properties.end() ? 0 : iter->second;
+        }
+
+        /**
+         * Record a change.
+         *
+         * @param kind  What happened.
+         * @param first First element affected, or the property.
+         * @param count Number of elements affected.
+         * @return      The new version.
+         */
+        unsigned long record(Change::Kind kind, unsigned int first, unsigned int count)
+        {
+            _version++;
+            if (kind == Change::PROPERTY) _properties[first] = _version;
+            _entries.push_back(Change(kind, first, count, _version));
+            if (_entries.size() - _head > _capacity) {
+                _forgotten = _entries[_head].version;
+                _head++;
+                if (_head * 2 >= _entries.size()) {
+                    _entries.erase(_entries.begin(), _entries.begin() + _head);
+                    _head = 0;
+                }
+            }
+            return _version;
+        }
+
+        /**
+         * Get what changed after a version, with neighbouring changes of
+         * the same kind merged into single ranges.  Updates to elements
+         * inserted after the version are folded into the insertion.
+         *
+         * @param version   Version already seen.
+         * @param changes   Receives the changes, in order.
+         * @return          False if the journal no longer reaches back that
+         *                  far, in which case the observer should refresh
+         *                  everything.
+         */
+        bool changesSince(unsigned long version, ChangeList &changes) const
+        {
+            changes.clear();
+            if (version < _forgotten) return false;
+            for (unsigned int i = _head; i < _entries.size(); i++) {
+                const Change &change = _entries[i];
+                if (change.version <= version) continue;
+                if (!changes.empty() && merge(changes.back(), change)) continue;
+                changes.push_back(change);
+            }
+            return true;
+        }
+
+    private:
+        /**
+         * Fold a change into the previous one if they combine into a single
+         * range.
+         */
+        static bool merge(Change &last, const Change &change)
+        {
+            unsigned int end = last.first + last.count;
+            switch (change.kind) {
+                case Change::INSERTED:
+                    if (last.kind != Change::INSERTED) return false;
+                    if (change.first < last.first || change.first > end) return false;
+                    break;
+                case Change::REMOVED:
+                    if (last.kind != Change::REMOVED || change.first != last.first) return false;
+                    break;
+                case Change::UPDATED:
+                    if (last.kind == Change::INSERTED &&
+                            change.first >= last.first && change.first + change.count <= end) {
+                        last.version = change.version;
+                        return true;
+                    }
+                    if (last.kind != Change::UPDATED) return false;
+                    if (change.first > end || change.first + change.count < last.first) return false;
+                    if (change.first < last.first) last.first = change.first;
+                    if (change.first + change.count > end) end = change.first + change.count;
+                    last.count = end - last.first;
+                    last.version = change.version;
+                    return true;
+                default:
+                    return false;
+            }
+            last.count += change.count;
+            last.version = change.version;
+            return true;
+        }
+
+        unsigned long _version;
+        unsigned long _forgotten;
+        unsigned int _head;
+        unsigned int _capacity;
+        std::vector<Change> _entries;
+        std::map<int, unsigned long> _properties;
+};
+
+}
+
+#endif
@@ -0,0 +1,108 @@
+/**
+ * Copyright (c) 2008 Christopher Allen Ogden
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef SYD_FRAMEWORK_CHANNEL_H_
+#define SYD_FRAMEWORK_CHANNEL_H_
+
+#include <vector>
+#include <atomic>
+#include "macros.h"
+
+namespace sydmvc {
+
+/**
+ * A bounded, lock-free, single-producer single-consumer queue.  One thread
+ * may push and one other thread may pop at the same time.
+ */
+template <class T>
+class Channel
+{
+    public:
+        /**
+         * Constructor.
+         *
+         * @param capacity  Number of items the channel can hold, rounded up
+         *                  to a power of two.
+         */
+        explicit Channel(unsigned int capacity = 1024):_head(0),_tail(0)
+        {
+            unsigned int size = 1;
+            while (size < capacity) size <<= 1;
+            _items.resize(size);
+            _mask = size - 1;
+        }
+
+        /**
+         * Push an item.  Producer side only.
+         *
+         * @param item  Item to push.
+         * @return      False if the channel is full.
+         */
+        bool push(const T &item)
+        {
+            unsigned int tail = _tail.load(std::memory_order_relaxed);
+            if (tail - _head.load(std::memory_order_acquire) > _mask) return false;
+            _items[tail & _mask] = item;
+            _tail.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        /**
+         * Pop an item.  Consumer side only.
+         *
+         * @param item  Set to the popped item.
+         * @return      False if the channel is empty.
+         */
+        bool pop(T &item)
+        {
+            unsigned int head = _head.load(std::memory_order_relaxed);
+            if (head == _tail.load(std::memory_order_acquire)) return false;
+            item = _items[head & _mask];
+            _head.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        /**
+         * Check whether the channel is empty.  Exact only on the consumer
+         * side.
+         *
+         * @return  True if there is nothing to pop.
+         */
+        bool empty() const
+        {
+            return _head.load(std::memory_order_acquire) == _tail.load(std::memory_order_acquire);
+        }
+
+    private:
+        std::vector<T> _items;
+        unsigned int _mask;
+        char _padHead[64];
+        std::atomic<unsigned int> _head;
+        char _padTail[64];
+        std::atomic<unsigned int> _tail;
+
+        DISALLOW_COPY_AND_ASSIGN(Channel);
+};
+
+}
+
+#endif
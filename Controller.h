@@ -63,8 +63,41 @@ class Controller: public Observer
          */
         virtual void attach()
         {
-            getFacade()->getSystem()->attach(this, getNotificationList());
+            getFacade()->getSystem()->attach(this, getNotificationList(), getPriority());
         }
+
+        /**
+         * Used by the system to order controllers.  Controllers with higher
+         * priorities see events first.
+         *
+         * @return  Priority of the controller.
+         */
+        virtual int getPriority() const
+        {
+            return 0;
+        }
+
+        /**
+         * Called by the system for each event.  Controllers that fully
+         * handle an event can return true to keep it from controllers
+         * further down.  By default it calls update() and passes the event
+         * on.
+         *
+         * @param event Event type.
+         * @return      True if the event was consumed.
+         */
+        virtual bool handle(int event)
+        {
+            update(event);
+            return false;
+        }
+
+        /**
+         * Empty update method.
+         *
+         * @param event Event type.
+         */
+        virtual void update(int event) {}
        
         /**
          * Used by the system to request a list of notification types
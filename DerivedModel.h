@@ -0,0 +1,211 @@
+/**
+ * Copyright (c) 2008 Christopher Allen Ogden
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef SYD_FRAMEWORK_DERIVEDMODEL_H_
+#define SYD_FRAMEWORK_DERIVEDMODEL_H_
+
+#include <vector>
+#include "Model.h"
+
+namespace sydmvc {
+
+/**
+ * A model whose value is a pure function of other models.  The models it
+ * reads while computing are tracked automatically, as long as their
+ * accessors call Model::read().  When any of them changes, the value is
+ * only marked stale; it is recomputed on the next get(), at most once
+ * however many sources changed.  Observers are notified only after the
+ * change has marked everything it reaches, so a model reached through
+ * several paths (a diamond) is notified once and, when read from an
+ * observer, recomputed once from up-to-date inputs.
+ */
+template <class T>
+class DerivedModel: public Model, public ModelDependent
+{
+    public:
+        /**
+         * Get the value, recomputing it first if it is stale.
+         *
+         * @return  Current value.
+         */
+        const T &get()
+        {
+            read();
+            if (_stale) recompute();
+            return _value;
+        }
+
+        /**
+         * Recompute the value now if it is stale.
+         */
+        virtual void refresh()
+        {
+            if (_stale) recompute();
+        }
+
+        /**
+         * Check whether the value needs recomputing.
+         *
+         * @return  True if stale.
+         */
+        bool isStale() const
+        {
+            return _stale;
+        }
+
+        /**
+         * Destructor.  Stops depending on the sources.
+         */
+        virtual ~DerivedModel()
+        {
+            for (typename SourceList::iterator iter = _sources.begin();
+                    iter != _sources.end();
+                    iter++) {
+                (*iter)->removeDependent(this);
+            }
+        }
+
+        virtual bool invalidate()
+        {
+            if (_stale) return false;
+            _stale = true;
+            invalidateDependents();
+            return true;
+        }
+
+        virtual void invalidated()
+        {
+            notify(_event);
+        }
+
+        virtual void depend(Model * const source)
+        {
+            if (source == this) return;
+            for (typename SourceList::iterator iter = _sources.begin();
+                    iter != _sources.end();
+                    iter++) {
+                if ((*iter) == source) return;
+            }
+            _sources.push_back(source);
+            source->addDependent(this);
+        }
+
+        virtual void forget(Model * const source)
+        {
+            for (typename SourceList::iterator iter = _sources.begin();
+                    iter != _sources.end();
+                    iter++) {
+                if ((*iter) == source) {
+                    _sources.erase(iter);
+                    break;
+                }
+            }
+            invalidateDependent(this);
+        }
+
+    protected:
+        /**
+         * Constructor.
+         *
+         * @param event Event observers are notified with when the value
+         *              goes stale.
+         */
+        explicit DerivedModel(int event):_event(event),_stale(true),_value() {}
+
+        /**
+         * Compute the value from the source models.
+         *
+         * @return  The value.
+         */
+        virtual T compute() = 0;
+
+    private:
+        typedef std::vector<Model *> SourceList;
+
+        /**
+         * Makes a dependent the one being computed on this thread for as
+         * long as it lives.
+         */
+        class Evaluation
+        {
+            public:
+                explicit Evaluation(ModelDependent * const dependent):_outer(evaluating())
+                {
+                    evaluating() = dependent;
+                }
+
+                ~Evaluation()
+                {
+                    evaluating() = _outer;
+                }
+
+            private:
+                ModelDependent *_outer;
+
+                DISALLOW_COPY_AND_ASSIGN(Evaluation);
+        };
+
+        /**
+         * Compute the value, recording which models it reads, and stop
+         * depending on models it no longer reads.  If compute() throws,
+         * the value stays stale and the previous sources are kept.
+         */
+        void recompute()
+        {
+            SourceList previous;
+            previous.swap(_sources);
+            try {
+                Evaluation evaluation(this);
+                _value = compute();
+            } catch (...) {
+                for (typename SourceList::iterator iter = previous.begin();
+                        iter != previous.end();
+                        iter++) {
+                    depend(*iter);
+                }
+                throw;
+            }
+            _stale = false;
+            for (typename SourceList::iterator iter = previous.begin();
+                    iter != previous.end();
+                    iter++) {
+                bool kept = false;
+                for (typename SourceList::iterator inner = _sources.begin();
+                        inner != _sources.end();
+                        inner++) {
+                    if ((*inner) == (*iter)) kept = true;
+                }
+                if (!kept) (*iter)->removeDependent(this);
+            }
+        }
+
+        int _event;
+        bool _stale;
+        T _value;
+        SourceList _sources;
+
+        DISALLOW_COPY_AND_ASSIGN(DerivedModel);
+};
+
+}
+
+#endif
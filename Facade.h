@@ -25,10 +25,19 @@
 
 #include <vector>
 #include <map>
+#include <utility>
+#include <cstdio>
+#include <chrono>
 #include "Controller.h"
 #include "System.h"
 #include "ViewObject.h"
+#include "ViewFactory.h"
 #include "Model.h"
+#include "TimerWheel.h"
+#include "TaskQueue.h"
+#include "BufferedState.h"
+#include "RenderThread.h"
+#include "ModelGraph.h"
 
 namespace sydmvc {
 
@@ -47,7 +56,7 @@ class Facade
         /**
          * Constructor.
          */
-        Facade():_quit(false),_system(NULL)
+        Facade():_quit(false),_system(NULL),_renderer(NULL),_renderKey(0),_pool(NULL)
         {
         }
 
@@ -56,6 +65,9 @@ class Facade
          */
         virtual ~Facade()
         {
+            stopRenderer();
+            if (_pool) delete _pool;
+            _pool = NULL;
             for (typename ControllerList::iterator iter = _controllers.begin();
                     iter != _controllers.end();
                     iter++) {
@@ -68,6 +80,11 @@ class Facade
                 if (iter->second) delete iter->second;
                 iter->second = NULL;
             }
+            for (typename FactoryList::iterator iter = _factories.begin();
+                    iter != _factories.end();
+                    iter++) {
+                delete iter->second;
+            }
             for (typename ModelList::iterator iter = _models.begin();
                     iter != _models.end();
                     iter++) {
@@ -102,31 +119,110 @@ class Facade
         }
 
         /**
-         * Attach a view to the facade.
+         * Attach a view to the facade.  Replacing the view drawn by the
+         * render thread stops the render thread.
          *
          * @param key   Key to attach the view with.
          * @param view  View to attach.
          */
         virtual void attachView(int key, ViewObject<I> * const view)
         {
+            if (_renderer && key == _renderKey) stopRenderer();
             typename ViewList::iterator iter = _views.find(key);
             if (iter != _views.end()) {
                 delete (iter->second);
             }
+            typename FactoryList::iterator factory = _factories.find(key);
+            if (factory != _factories.end()) {
+                delete (factory->second);
+                _factories.erase(factory);
+                _viewsUsed.erase(key);
+            }
+            view->setTreeLock(&_viewTree);
             view->setFacade(this);
             view->attach();
+            restoreView(key, view);
             _views[key] = view;
         }
 
         /**
-         * Get a view that has been attached.
+         * Register a view to be created when it is first needed.  The view
+         * is built, given the facade and attached on the first getView()
+         * for its key.
+         *
+         * @param key       Key to register the view with.
+         * @param factory   Factory that creates the view.  The facade takes
+         *                  ownership of it.
+         */
+        virtual void registerView(int key, ViewFactory<I> * const factory)
+        {
+            if (_renderer && key == _renderKey) stopRenderer();
+            typename ViewList::iterator iter = _views.find(key);
+            if (iter != _views.end()) {
+                if (iter->second) delete (iter->second);
+                _views.erase(iter);
+            }
+            typename FactoryList::iterator factoryIter = _factories.find(key);
+            if (factoryIter != _factories.end()) {
+                delete (factoryIter->second);
+            }
+            _factories[key] = factory;
+        }
+
+        /**
+         * Get a view that has been attached, creating it first if it was
+         * registered and has not been created yet.
          *
          * @param key   Key of the view to return.
          * @return      View associated with the key.
          */
         virtual ViewObject<I> *getView(int key) 
         {
-            return _views[key];
+            ViewObject<I> *&view = _views[key];
+            typename FactoryList::iterator iter = _factories.find(key);
+            if (iter == _factories.end()) return view;
+            if (!view) {
+                view = iter->second->create();
+                view->setTreeLock(&_viewTree);
+                view->setFacade(this);
+                view->attach();
+                restoreView(key, view);
+            }
+            _viewsUsed[key] = getTicks();
+            return view;
+        }
+
+        /**
+         * Destroy registered views that have not been asked for in a
+         * while.  They are detached first, and will be created again when
+         * they are next needed.  Only views whose factory allows it are
+         * evicted, and never the view being drawn by the render thread.
+         *
+         * @param idle  Milliseconds a view may go unused before it is
+         *              destroyed.
+         */
+        virtual void evictViews(unsigned long idle)
+        {
+            unsigned long now = getTicks();
+            typename UseList::iterator iter = _viewsUsed.begin();
+            while (iter != _viewsUsed.end()) {
+                typename FactoryList::iterator factory = _factories.find(iter->first);
+                if (now - iter->second < idle || factory == _factories.end() ||
+                        !factory->second->isEvictable() ||
+                        (_renderer && iter->first == _renderKey)) {
+                    iter++;
+                    continue;
+                }
+                typename ViewList::iterator view = _views.find(iter->first);
+                if (view != _views.end()) {
+                    if (view->second) {
+                        view->second->detach();
+                        delete (view->second);
+                    }
+                    _views.erase(view);
+                }
+                _viewsUsed.erase(iter++);
+            }
         }
 
         /**
@@ -139,9 +235,13 @@ class Facade
         {
             ModelList::iterator iter = _models.find(key);
             if (iter != _models.end()) {
+                _modelGraph.remove(iter->second);
                 delete (iter->second);
             }
             _models[key] = model;
+            _modelGraph.add(model);
+            ImageReader reader;
+            if (_image.find(ImageWriter::MODEL, key, reader)) model->restore(reader);
         }
 
         /**
@@ -155,6 +255,137 @@ class Facade
             return _models[key];
         }
 
+        /**
+         * Set how many threads tick models besides the main thread.  Models
+         * are ticked once per cycle in waves ordered by their inputs; with
+         * no threads every model ticks on the main thread.
+         *
+         * @param threads   Number of worker threads.
+         */
+        virtual void setUpdateThreads(unsigned int threads)
+        {
+            if (_pool) delete _pool;
+            _pool = threads ? new ThreadPool(threads) : NULL;
+        }
+
+        /**
+         * Let the facade know that a model's inputs have changed.
+         */
+        virtual void invalidateModelGraph()
+        {
+            _modelGraph.invalidate();
+        }
+
+        /**
+         * Write the state of the models and of the views created so far to
+         * an image that a later run can warm start from.
+         *
+         * @param path      Path of the image file.
+         * @param schema    Application-defined layout version.
+         * @return          False if the image could not be written.
+         */
+        virtual bool saveImage(const char * const path, unsigned int schema = 0)
+        {
+            ImageWriter writer(schema);
+            for (ModelList::iterator iter = _models.begin();
+                    iter != _models.end();
+                    iter++) {
+                if (!iter->second) continue;
+                writer.section(ImageWriter::MODEL, iter->first);
+                iter->second->save(writer);
+            }
+            for (typename ViewList::iterator iter = _views.begin();
+                    iter != _views.end();
+                    iter++) {
+                if (!iter->second) continue;
+                writer.section(ImageWriter::VIEW, iter->first);
+                iter->second->save(writer);
+            }
+            return writer.save(path);
+        }
+
+        /**
+         * Map an image written by saveImage().  Models and views attached
+         * from then on, including views created lazily, are restored from
+         * it, so this is usually called before init().  The image stays
+         * mapped for the life of the facade.
+         *
+         * @param path      Path of the image file.
+         * @param schema    Layout version the image must have.
+         * @return          False if there is no usable image, in which
+         *                  case everything starts cold.
+         */
+        virtual bool loadImage(const char * const path, unsigned int schema = 0)
+        {
+            return _image.load(path, schema);
+        }
+
+        /**
+         * Get the image being warm started from.
+         *
+         * @return  The image; not loaded if starting cold.
+         */
+        const Image &getImage() const
+        {
+            return _image;
+        }
+
+        /**
+         * Measure the footprint of each model and view in the registry and
+         * raise its high-water mark.  Footprints are walked, not counted
+         * as they change, so peaks are the highest seen at any sample;
+         * call this at moments worth tracking, such as after loading.
+         */
+        virtual void sampleMemory()
+        {
+            for (ModelList::const_iterator iter = _models.begin();
+                    iter != _models.end();
+                    iter++) {
+                if (!iter->second) continue;
+                std::size_t &peak = _modelPeaks[iter->first];
+                std::size_t bytes = iter->second->footprint();
+                if (bytes > peak) peak = bytes;
+            }
+            for (typename ViewList::const_iterator iter = _views.begin();
+                    iter != _views.end();
+                    iter++) {
+                if (!iter->second) continue;
+                std::size_t &peak = _viewPeaks[iter->first];
+                std::size_t bytes = iter->second->footprint();
+                if (bytes > peak) peak = bytes;
+            }
+        }
+
+        /**
+         * Print the memory used by the framework, by category, and by each
+         * model and view in the registry, with high-water marks.  Takes a
+         * sample first.  Only counts anything when built with
+         * SYD_FRAMEWORK_ACCOUNTING.
+         *
+         * @param out   Stream to print to.
+         */
+        virtual void reportMemory(std::FILE * const out)
+        {
+            sampleMemory();
+            MemoryAccounting::report(out);
+            for (ModelList::const_iterator iter = _models.begin();
+                    iter != _models.end();
+                    iter++) {
+                if (!iter->second) continue;
+                std::fprintf(out, "model %-10d %14lu %27lu\n", iter->first,
+                        (unsigned long)iter->second->footprint(),
+                        (unsigned long)_modelPeaks[iter->first]);
+            }
+            for (typename ViewList::const_iterator iter = _views.begin();
+                    iter != _views.end();
+                    iter++) {
+                if (!iter->second) continue;
+                std::fprintf(out, "view  %-10d %14lu %27lu\n", iter->first,
+                        (unsigned long)iter->second->footprint(),
+                        (unsigned long)_viewPeaks[iter->first]);
+            }
+        }
+
         /**
          * Initialize the system.
          */
@@ -176,21 +407,185 @@ class Facade
         virtual void attachModels() {}
 
         /**
-         * Main loop of the program.
+         * Set a timer.  When it expires, the observer is updated with the
+         * given event from the main loop.
+         *
+         * @param observer  Observer to update.
+         * @param event     Event type to update the observer with.
+         * @param delay     Milliseconds until the timer expires.  Delays
+         *                  beyond the wheel's reach of about 49 days are
+         *                  honoured by placing the timer again on the way.
+         * @param period    If non-zero, milliseconds between repeats.
+         * @return          Id of the timer, for cancelling it.
+         */
+        virtual TimerId setTimer(Observer * const observer, int event,
+                unsigned long delay, unsigned long period = 0)
+        {
+            return _timers.set(getTicks(), delay, observer, event, period);
+        }
+
+        /**
+         * Cancel a timer.
+         *
+         * @param id    Id of the timer to cancel.
+         * @return      True if the timer was still pending.
+         */
+        virtual bool cancelTimer(const TimerId &id)
+        {
+            return _timers.cancel(id);
+        }
+
+        /**
+         * Get the current time used for timers.
+         *
+         * @return  Milliseconds on a monotonic clock.
+         */
+        virtual unsigned long getTicks() const
+        {
+            return std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        /**
+         * Post an update to be delivered from the main loop once the
+         * current events have been handled.  Useful for reacting to a
+         * notification without doing the work inside its dispatch.
+         *
+         * @param observer  Observer to update.
+         * @param event     Event type to update the observer with.
+         */
+        virtual void post(Observer * const observer, int event)
+        {
+            _posted.push_back(std::make_pair(observer, event));
+        }
+
+        /**
+         * Withdraw every update posted to an observer that has not been
+         * delivered yet, for instance before destroying it.
+         *
+         * @param observer  Observer whose updates to withdraw.
+         */
+        virtual void cancelPosts(Observer * const observer)
+        {
+            typename PostList::iterator iter = _posted.begin();
+            while (iter != _posted.end()) {
+                if (iter->first == observer) {
+                    iter = _posted.erase(iter);
+                } else {
+                    iter++;
+                }
+            }
+            for (iter = _delivering.begin(); iter != _delivering.end(); iter++) {
+                if (iter->first == observer) iter->first = NULL;
+            }
+        }
+
+        /**
+         * Add a background task.  The facade takes ownership of it and
+         * deletes it once it finishes.
+         *
+         * @param task      Task to add.
+         * @param priority  Higher priorities run first.
+         */
+        virtual void addTask(Task * const task, int priority = 0)
+        {
+            _tasks.add(task, priority);
+        }
+
+        /**
+         * Set the target time for one cycle of the main loop.  Tasks get
+         * whatever the rest of the cycle leaves of it.
+         *
+         * @param frame     Target time, in microseconds.
+         * @param minimum   Smallest budget given to tasks, in microseconds.
+         */
+        virtual void setFrameTime(long frame, long minimum = 1000)
+        {
+            _tasks.setFrameTime(frame, minimum);
+        }
+
+        /**
+         * Main loop of the program.  The system is allowed to block until
+         * the next timer is due, then all expired timers are fired and the
+         * models are ticked.  Tasks run in whatever time is left of the
+         * cycle.
          */
         virtual void run()
         {
             while (!_quit) {
-                if (_system) _system->handleEvents();
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                bool busy = !_tasks.empty();
+                if (_system) _system->waitEvents(nextTimeout());
+                _timers.advance(getTicks());
+                deliverPosted();
+                _modelGraph.tick(_pool);
                 idle();
+                long cost = std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now() - start).count();
+                _tasks.run(busy ? cost : -1);
+                endFrame();
             }
         }
 
+        /**
+         * Attach model state that should be published to the render thread
+         * at the end of every frame.
+         *
+         * @param buffer    Buffer to publish; owned by its model.
+         */
+        virtual void attachBuffer(StateBuffer * const buffer)
+        {
+            _buffers.add(buffer);
+        }
+
+        /**
+         * Draw a view on a render thread from now on.  The view is drawn
+         * once per frame, against the state published at the end of it.
+         *
+         * @param key   Key of the view to draw.
+         */
+        virtual void startRenderer(int key)
+        {
+            stopRenderer();
+            _renderer = new RenderThread<I>(getView(key), _system, &_buffers, &_viewTree);
+            _renderKey = key;
+        }
+
+        /**
+         * Stop the render thread, if any, once it has drawn its current
+         * frame.
+         */
+        virtual void stopRenderer()
+        {
+            if (_renderer) delete _renderer;
+            _renderer = NULL;
+        }
+
+        /**
+         * Called at the end of every cycle of the main loop.  Publishes the
+         * attached buffers and signals the render thread.
+         */
+        virtual void endFrame()
+        {
+            _buffers.publish();
+            if (_renderer) _renderer->signal();
+        }
+
         /**
          * Called once per cycle, if there are no events.
          */
         virtual void idle(void) {}
 
+        /**
+         * Called when a message arrives from another shard.  Only used when
+         * the facade runs as one shard of a ShardedFacade.
+         *
+         * @param key   Routing key of the message.
+         * @param event Event type.
+         * @param data  Payload, owned by the receiver from here on.
+         */
+        virtual void receive(int key, int event, void *data) {}
+
         /**
          * Cause the main loop to terminate.
          */
@@ -218,14 +613,81 @@ class Facade
         {
             _system = system;
         }
+    protected:
+        /**
+         * Get how long the main loop may wait for events.
+         *
+         * @return  Milliseconds until the next timer or model poll, 0 if
+         *          tasks or posted updates are waiting, or -1 if there is
+         *          nothing to wait for.
+         */
+        virtual long nextTimeout() const
+        {
+            unsigned long next;
+            if (!_tasks.empty() || !_posted.empty()) return 0;
+            long poll = _modelGraph.getPollInterval();
+            if (!_timers.nextExpiry(next)) return poll;
+            unsigned long now = getTicks();
+            long timeout = next > now ? (long)(next - now) : 0;
+            return poll >= 0 && poll < timeout ? poll : timeout;
+        }
+
+        /**
+         * Restore a view from the image, if it has the view's state.
+         */
+        void restoreView(int key, ViewObject<I> * const view)
+        {
+            ImageReader reader;
+            if (_image.find(ImageWriter::VIEW, key, reader)) view->restore(reader);
+        }
+
+        /**
+         * Deliver posted updates.  Updates posted meanwhile wait for the
+         * next cycle.
+         */
+        void deliverPosted()
+        {
+            _delivering.swap(_posted);
+            for (typename PostList::iterator iter = _delivering.begin();
+                    iter != _delivering.end();
+                    iter++) {
+                if (iter->first) iter->first->update(iter->second);
+            }
+            _delivering.clear();
+        }
+
     private:
         bool _quit;
         System<I> *_system;
+        TimerWheel _timers;
+        TaskQueue _tasks;
+        typedef std::vector<std::pair<Observer *, int> > PostList;
+        PostList _posted;
+        PostList _delivering;
+        StateBufferSet _buffers;
+        RenderThread<I> *_renderer;
+        int _renderKey;
+        std::mutex _viewTree;
+        ModelGraph _modelGraph;
+        ThreadPool *_pool;
+        Image _image;
         typedef std::vector<Controller<I> *> ControllerList;
         ControllerList _controllers;
-        typedef std::map<int, ViewObject<I> *> ViewList;
+        typedef std::map<int, ViewObject<I> *, std::less<int>,
+                AccountedAllocator<std::pair<const int, ViewObject<I> *>, MEMORY_REGISTRY> > ViewList;
         ViewList _views;
-        typedef std::map<int, Model *> ModelList;
+        typedef std::map<int, ViewFactory<I> *, std::less<int>,
+                AccountedAllocator<std::pair<const int, ViewFactory<I> *>, MEMORY_REGISTRY> > FactoryList;
+        FactoryList _factories;
+        typedef std::map<int, unsigned long, std::less<int>,
+                AccountedAllocator<std::pair<const int, unsigned long>, MEMORY_REGISTRY> > UseList;
+        UseList _viewsUsed;
+        typedef std::map<int, std::size_t, std::less<int>,
+                AccountedAllocator<std::pair<const int, std::size_t>, MEMORY_REGISTRY> > PeakList;
+        PeakList _modelPeaks;
+        PeakList _viewPeaks;
+        typedef std::map<int, Model *, std::less<int>,
+                AccountedAllocator<std::pair<const int, Model *>, MEMORY_REGISTRY> > ModelList;
         ModelList _models;
 
         DISALLOW_COPY_AND_ASSIGN(Facade);
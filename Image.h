@@ -0,0 +1,420 @@
+/**
+ * Copyright (c) 2008 Christopher Allen Ogden
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef SYD_FRAMEWORK_IMAGE_H_
+#define SYD_FRAMEWORK_IMAGE_H_
+
+#include <vector>
+#include <algorithm>
+#include <string>
+#include <cstdio>
+#include <cstring>
+#include <cstddef>
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define SYD_FRAMEWORK_IMAGE_MMAP 1
+#endif
+#include "macros.h"
+
+namespace sydmvc {
+
+/**
+ * Builds an image: a file of numbered sections that a later process maps
+ * straight into memory.  Everything in a section is addressed by its
+ * position in the section, so the image works wherever it is mapped.
+ * Each write is aligned to 8 bytes, so arrays of plain structures can be
+ * used in place once mapped.
+ */
+class ImageWriter
+{
+    public:
+        /**
+         * Kinds of sections written by the facade.  Applications may use
+         * kinds from USER up.
+         */
+        enum {
+            MODEL = 1,
+            VIEW = 2,
+            USER = 16
+        };
+
+        /**
+         * Constructor.
+         *
+         * @param schema    Application-defined layout version.  An image is
+         *                  only loaded by code expecting the same schema.
+         */
+        explicit ImageWriter(unsigned int schema = 0):_schema(schema),_open(false) {}
+
+        /**
+         * Start a section.  Writes go to it until the next section starts.
+         * Sections left empty are dropped.
+         *
+         * @param kind  Kind of section, such as MODEL or VIEW.
+         * @param key   Key of the section within its kind.
+         */
+        void section(unsigned int kind, int key)
+        {
+            close();
+            Entry entry = { kind, key, _data.size(), 0 };
+            _entries.push_back(entry);
+            _open = true;
+        }
+
+        /**
+         * Append bytes to the current section.
+         *
+         * @param data  Bytes to append.
+         * @param size  Number of bytes.
+         */
+        void write(const void * const data, std::size_t size)
+        {
+            _data.resize(align(_data.size()));
+            std::size_t at = _data.size();
+            _data.resize(at + size);
+            if (size) std::memcpy(&_data[at], data, size);
+        }
+
+        /**
+         * Append a value to the current section.
+         *
+         * @param value Plain value to append.
+         */
+        template <class T>
+        void write(const T &value)
+        {
+            write(&value, sizeof(T));
+        }
+
+        /**
+         * Write the image to a file.  It is written next to the target
+         * and renamed over it, so a process that has the old image mapped
+         * keeps seeing the old contents.
+         *
+         * @param path  Path of the file.
+         * @return      False if the file could not be written.
+         */
+        bool save(const char * const path)
+        {
+            close();
+            std::stable_sort(_entries.begin(), _entries.end(), before);
+            Header header;
+            std::memcpy(header.magic, magic(), sizeof(header.magic));
+            header.format = FORMAT;
+            header.schema = _schema;
+            header.sections = _entries.size();
+            header.reserved = 0;
+            std::size_t base = align(sizeof(Header) + _entries.size() * sizeof(Entry));
+            for (std::vector<Entry>::iterator iter = _entries.begin();
+                    iter != _entries.end();
+                    iter++) {
+                iter->offset += base;
+            }
+            std::string temporary(path);
+            temporary += ".tmp";
+            std::FILE *file = std::fopen(temporary.c_str(), "wb");
+            if (!file) return false;
+            bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1;
+            if (ok && !_entries.empty()) {
+                ok = std::fwrite(&_entries[0], sizeof(Entry), _entries.size(), file) == _entries.size();
+            }
+            static const char padding[ALIGN] = { 0 };
+            std::size_t pad = base - sizeof(Header) - _entries.size() * sizeof(Entry);
+            if (ok && pad) ok = std::fwrite(padding, 1, pad, file) == pad;
+            if (ok && !_data.empty()) ok = std::fwrite(&_data[0], 1, _data.size(), file) == _data.size();
+            for (std::vector<Entry>::iterator iter = _entries.begin();
+                    iter != _entries.end();
+                    iter++) {
+                iter->offset -= base;
+            }
+            ok = std::fclose(file) == 0 && ok;
+#ifndef SYD_FRAMEWORK_IMAGE_MMAP
+            if (ok) std::remove(path);
+#endif
+            if (ok) ok = std::rename(temporary.c_str(), path) == 0;
+            if (!ok) std::remove(temporary.c_str());
+            return ok;
+        }
+
+    private:
+        friend class Image;
+        enum { ALIGN = 8, FORMAT = 2 };
+
+        /**
+         * Bytes every image starts with.
+         */
+        static const char *magic()
+        {
+            return "SYDIMG\0";
+        }
+
+        struct Header
+        {
+            char magic[8];
+            unsigned int format;
+            unsigned int schema;
+            unsigned int sections;
+            unsigned int reserved;
+        };
+
+        struct Entry
+        {
+            unsigned int kind;
+            int key;
+            unsigned long long offset;
+            unsigned long long size;
+        };
+
+        /**
+         * Order of the section table, which readers binary-search.
+         */
+        static bool before(const Entry &left, const Entry &right)
+        {
+            return left.kind < right.kind || (left.kind == right.kind && left.key < right.key);
+        }
+
+        static std::size_t align(std::size_t size)
+        {
+            return (size + ALIGN - 1) & ~(std::size_t)(ALIGN - 1);
+        }
+
+        /**
+         * Finish the current section.
+         */
+        void close()
+        {
+            if (!_open) return;
+            _data.resize(align(_data.size()));
+            _entries.back().size = _data.size() - _entries.back().offset;
+            if (_entries.back().size == 0) _entries.pop_back();
+            _open = false;
+        }
+
+        unsigned int _schema;
+        bool _open;
+        std::vector<Entry> _entries;
+        std::vector<char> _data;
+
+        DISALLOW_COPY_AND_ASSIGN(ImageWriter);
+};
+
+/**
+ * Reads a section of an image in the order it was written.  Reads return
+ * pointers into the mapped image rather than copies.
+ */
+class ImageReader
+{
+    public:
+        ImageReader():_data(NULL),_size(0),_at(0) {}
+        ImageReader(const char * const data, std::size_t size):_data(data),_size(size),_at(0) {}
+
+        /**
+         * Read bytes.
+         *
+         * @param size  Number of bytes.
+         * @return      Pointer to the bytes in the image, or NULL if the
+         *              section is too short.
+         */
+        const void *read(std::size_t size)
+        {
+            std::size_t at = (_at + 7) & ~(std::size_t)7;
+            if (at > _size || size > _size - at) return NULL;
+            _at = at + size;
+            return _data + at;
+        }
+
+        /**
+         * Read a value.
+         *
+         * @param value Set to the value read.
+         * @return      False if the section is too short.
+         */
+        template <class T>
+        bool read(T &value)
+        {
+            const void *data = read(sizeof(T));
+            if (!data) return false;
+            std::memcpy(&value, data, sizeof(T));
+            return true;
+        }
+
+        /**
+         * Check whether there is nothing left to read.
+         *
+         * @return  True at the end of the section.
+         */
+        bool atEnd() const
+        {
+            return _at >= _size;
+        }
+
+    private:
+        const char *_data;
+        std::size_t _size;
+        std::size_t _at;
+};
+
+/**
+ * An image mapped into memory.  Pointers returned by readers stay valid
+ * for as long as the image is loaded.
+ */
+class Image
+{
+    public:
+        Image():_data(NULL),_size(0),_mapped(false) {}
+
+        /**
+         * Destructor.  Unmaps the image.
+         */
+        ~Image()
+        {
+            unload();
+        }
+
+        /**
+         * Map an image file.
+         *
+         * @param path      Path of the file.
+         * @param schema    Schema the image must have been written with.
+         * @return          False if the file is missing, malformed or has a
+         *                  different schema.
+         */
+        bool load(const char * const path, unsigned int schema = 0)
+        {
+            unload();
+#ifdef SYD_FRAMEWORK_IMAGE_MMAP
+            int fd = ::open(path, O_RDONLY);
+            if (fd < 0) return false;
+            struct stat info;
+            if (::fstat(fd, &info) != 0 || info.st_size <= 0) {
+                ::close(fd);
+                return false;
+            }
+            void *data = ::mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            ::close(fd);
+            if (data == MAP_FAILED) return false;
+            _data = static_cast<const char *>(data);
+            _size = info.st_size;
+            _mapped = true;
+#else
+            std::FILE *file = std::fopen(path, "rb");
+            if (!file) return false;
+            char buffer[4096];
+            std::size_t count;
+            while ((count = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+                _copy.insert(_copy.end(), buffer, buffer + count);
+            }
+            std::fclose(file);
+            if (_copy.empty()) return false;
+            _data = &_copy[0];
+            _size = _copy.size();
+#endif
+            if (!valid(schema)) {
+                unload();
+                return false;
+            }
+            return true;
+        }
+
+        /**
+         * Unmap the image.
+         */
+        void unload()
+        {
+#ifdef SYD_FRAMEWORK_IMAGE_MMAP
+            if (_mapped) ::munmap(const_cast<char *>(_data), _size);
+#endif
+            _copy.clear();
+            _data = NULL;
+            _size = 0;
+            _mapped = false;
+        }
+
+        /**
+         * Check whether an image is loaded.
+         *
+         * @return  True if loaded.
+         */
+        bool isLoaded() const
+        {
+            return _data != NULL;
+        }
+
+        /**
+         * Get a reader for a section.
+         *
+         * @param kind      Kind of the section.
+         * @param key       Key of the section.
+         * @param reader    Set to a reader for the section.
+         * @return          False if there is no such section.
+         */
+        bool find(unsigned int kind, int key, ImageReader &reader) const
+        {
+            if (!_data) return false;
+            const Header *header = reinterpret_cast<const Header *>(_data);
+            const Entry *entries = reinterpret_cast<const Entry *>(_data + sizeof(Header));
+            const Entry *end = entries + header->sections;
+            Entry wanted = { kind, key, 0, 0 };
+            const Entry *found = std::lower_bound(entries, end, wanted, ImageWriter::before);
+            if (found == end || found->kind != kind || found->key != key) return false;
+            reader = ImageReader(_data + found->offset, found->size);
+            return true;
+        }
+
+    private:
+        typedef ImageWriter::Header Header;
+        typedef ImageWriter::Entry Entry;
+
+        /**
+         * Check the header and section table.
+         */
+        bool valid(unsigned int schema) const
+        {
+            if (_size < sizeof(Header)) return false;
+            const Header *header = reinterpret_cast<const Header *>(_data);
+            if (std::memcmp(header->magic, ImageWriter::magic(), sizeof(header->magic)) != 0) return false;
+            if (header->format != ImageWriter::FORMAT || header->schema != schema) return false;
+            if (header->sections > (_size - sizeof(Header)) / sizeof(Entry)) return false;
+            const Entry *entries = reinterpret_cast<const Entry *>(_data + sizeof(Header));
+            for (unsigned int i = 0; i < header->sections; i++) {
+                if (entries[i].offset > _size || entries[i].size > _size - entries[i].offset) {
+                    return false;
+                }
+                if (i > 0 && ImageWriter::before(entries[i], entries[i - 1])) return false;
+            }
+            return true;
+        }
+
+        const char *_data;
+        std::size_t _size;
+        bool _mapped;
+        std::vector<char> _copy;
+
+        DISALLOW_COPY_AND_ASSIGN(Image);
+};
+
+}
+
+#endif
@@ -0,0 +1,339 @@
+/**
+ * Copyright (c) 2008 Christopher Allen Ogden
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef SYD_FRAMEWORK_MEMORYACCOUNTING_H_
+#define SYD_FRAMEWORK_MEMORYACCOUNTING_H_
+
+#include <cstddef>
+#include <cstdio>
+#include <new>
+#include <atomic>
+#include "macros.h"
+
+namespace sydmvc {
+
+/**
+ * What framework memory is used for.
+ */
+enum MemoryCategory {
+    MEMORY_MODELS,
+    MEMORY_VIEWS,
+    MEMORY_VIEW_TREES,
+    MEMORY_OBSERVERS,
+    MEMORY_NOTIFICATIONS,
+    MEMORY_REGISTRY,
+    MEMORY_CATEGORIES
+};
+
+/**
+ * Memory used by one category.
+ */
+class MemoryUsage
+{
+    public:
+        MemoryUsage():bytes(0),allocations(0),peak(0) {}
+
+        /**
+         * Bytes currently allocated.
+         */
+        std::size_t bytes;
+
+        /**
+         * Allocations currently live.
+         */
+        std::size_t allocations;
+
+        /**
+         * Most bytes ever allocated at once.
+         */
+        std::size_t peak;
+};
+
+/**
+ * Counts the memory the framework allocates, by category.  Counting only
+ * happens when SYD_FRAMEWORK_ACCOUNTING is defined; otherwise every count
+ * stays at zero and nothing costs anything.  Counters are safe to update
+ * from any thread.
+ */
+class MemoryAccounting
+{
+    public:
+        /**
+         * Whether counting is compiled in.
+         *
+         * @return  True if SYD_FRAMEWORK_ACCOUNTING is defined.
+         */
+        static bool enabled()
+        {
+#ifdef SYD_FRAMEWORK_ACCOUNTING
+            return true;
+#else
+            return false;
+#endif
+        }
+
+        /**
+         * Record an allocation.
+         *
+         * @param category  Category of the memory.
+         * @param bytes     Size of the allocation.
+         */
+        static void allocated(MemoryCategory category, std::size_t bytes)
+        {
+#ifdef SYD_FRAMEWORK_ACCOUNTING
+            Counter &counter = counters()[category];
+            std::size_t total = counter.bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+            counter.allocations.fetch_add(1, std::memory_order_relaxed);
+            std::size_t peak = counter.peak.load(std::memory_order_relaxed);
+            while (total > peak && !counter.peak.compare_exchange_weak(peak, total,
+                        std::memory_order_relaxed)) {
+            }
+#endif
+        }
+
+        /**
+         * Record a deallocation.
+         *
+         * @param category  Category of the memory.
+         * @param bytes     Size of the allocation.
+         */
+        static void released(MemoryCategory category, std::size_t bytes)
+        {
+#ifdef SYD_FRAMEWORK_ACCOUNTING
+            Counter &counter = counters()[category];
+            counter.bytes.fetch_sub(bytes, std::memory_order_relaxed);
+            counter.allocations.fetch_sub(1, std::memory_order_relaxed);
+#endif
+        }
+
+        /**
+         * Get the memory used by a category.
+         *
+         * @param category  Category to look up.
+         * @return          Usage of the category.
+         */
+        static MemoryUsage usage(MemoryCategory category)
+        {
+            MemoryUsage usage;
+#ifdef SYD_FRAMEWORK_ACCOUNTING
+            Counter &counter = counters()[category];
+            usage.bytes = counter.bytes.load(std::memory_order_relaxed);
+            usage.allocations = counter.allocations.load(std::memory_order_relaxed);
+            usage.peak = counter.peak.load(std::memory_order_relaxed);
+#endif
+            return usage;
+        }
+
+        /**
+         * Get the name of a category.
+         *
+         * @param category  Category.
+         * @return          Its name.
+         */
+        static const char *name(MemoryCategory category)
+        {
+            static const char *names[MEMORY_CATEGORIES] = {
+                "models",
+                "views",
+                "view trees",
+                "observers",
+                "notifications",
+                "registry"
+            };
+            return names[category];
+        }
+
+        /**
+         * Print the usage of every category.
+         *
+         * @param out   Stream to print to.
+         */
+        static void report(std::FILE * const out)
+        {
+            std::fprintf(out, "%-16s %14s %12s %14s\n", "category", "bytes", "allocations", "peak");
+            for (int i = 0; i < MEMORY_CATEGORIES; i++) {
+                MemoryUsage u = usage((MemoryCategory)i);
+                std::fprintf(out, "%-16s %14lu %12lu %14lu\n", name((MemoryCategory)i),
+                        (unsigned long)u.bytes, (unsigned long)u.allocations, (unsigned long)u.peak);
+            }
+        }
+
+    private:
+#ifdef SYD_FRAMEWORK_ACCOUNTING
+        struct Counter
+        {
+            std::atomic<std::size_t> bytes;
+            std::atomic<std::size_t> allocations;
+            std::atomic<std::size_t> peak;
+        };
+
+        static Counter *counters()
+        {
+            static Counter counters[MEMORY_CATEGORIES];
+            return counters;
+        }
+#endif
+};
+
+/**
+ * Standard allocator that counts what it allocates against a category.
+ */
+template <class T, int C>
+class AccountedAllocator
+{
+    public:
+        typedef T value_type;
+
+        template <class U>
+        struct rebind
+        {
+            typedef AccountedAllocator<U, C> other;
+        };
+
+        AccountedAllocator() {}
+
+        template <class U>
+        AccountedAllocator(const AccountedAllocator<U, C> &) {}
+
+        T *allocate(std::size_t count)
+        {
+            MemoryAccounting::allocated((MemoryCategory)C, count * sizeof(T));
+            return static_cast<T *>(::operator new(count * sizeof(T)));
+        }
+
+        void deallocate(T * const pointer, std::size_t count)
+        {
+            MemoryAccounting::released((MemoryCategory)C, count * sizeof(T));
+            ::operator delete(pointer);
+        }
+
+        template <class U>
+        bool operator==(const AccountedAllocator<U, C> &) const
+        {
+            return true;
+        }
+
+        template <class U>
+        bool operator!=(const AccountedAllocator<U, C> &) const
+        {
+            return false;
+        }
+};
+
+/**
+ * Base for classes whose instances are counted against a category.  When
+ * counting is on, instances created with new remember the size they were
+ * allocated with, so per-object footprints can be reported.  Instances on
+ * the stack, inside other objects or in arrays are not counted and report
+ * a size of 0.
+ *
+ * Counting adds a member, so the layout of every model and view depends on
+ * SYD_FRAMEWORK_ACCOUNTING.  All translation units of a program must agree
+ * on it; mixing settings breaks the one-definition rule.
+ */
+template <int C>
+class AccountedObject
+{
+    public:
+        /**
+         * Get the size the object was allocated with.
+         *
+         * @return  Its size, or 0 if it was not allocated with new or
+         *          counting is off.
+         */
+        std::size_t accountedSize() const
+        {
+#ifdef SYD_FRAMEWORK_ACCOUNTING
+            return _accountedSize;
+#else
+            return 0;
+#endif
+        }
+
+#ifdef SYD_FRAMEWORK_ACCOUNTING
+        static void *operator new(std::size_t size)
+        {
+            void *memory = ::operator new(size);
+            MemoryAccounting::allocated((MemoryCategory)C, size);
+            Allocation &last = allocation();
+            last.memory = static_cast<char *>(memory);
+            last.size = size;
+            return memory;
+        }
+
+        static void operator delete(void *object, std::size_t size)
+        {
+            if (!object) return;
+            MemoryAccounting::released((MemoryCategory)C, size);
+            ::operator delete(object);
+        }
+
+        static void *operator new(std::size_t, void *place)
+        {
+            return place;
+        }
+
+        static void operator delete(void *, void *) {}
+
+    protected:
+        AccountedObject():_accountedSize(claim()) {}
+        AccountedObject(const AccountedObject &):_accountedSize(claim()) {}
+        AccountedObject &operator=(const AccountedObject &) { return *this; }
+
+    private:
+        /**
+         * The allocation most recently made on this thread.
+         */
+        struct Allocation
+        {
+            char *memory;
+            std::size_t size;
+        };
+
+        static Allocation &allocation()
+        {
+            static thread_local Allocation last = { NULL, 0 };
+            return last;
+        }
+
+        /**
+         * Take the size of the allocation the object is being built in, if
+         * it was made by operator new above.
+         */
+        std::size_t claim()
+        {
+            Allocation &last = allocation();
+            const char *self = reinterpret_cast<const char *>(this);
+            if (self < last.memory || self >= last.memory + last.size) return 0;
+            std::size_t size = last.size;
+            last.memory = NULL;
+            last.size = 0;
+            return size;
+        }
+
+        std::size_t _accountedSize;
+#endif
+};
+
+}
+
+#endif
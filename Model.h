@@ -23,30 +23,450 @@
 #ifndef SYD_FRAMEWORK_MODEL_H_
 #define SYD_FRAMEWORK_MODEL_H_
 
-#include "Subject.h"
+#include <vector>
+#include "SimpleSubject.h"
+#include "ModelObserver.h"
+#include "ChangeJournal.h"
+#include "Image.h"
+#include "MemoryAccounting.h"
 
 namespace sydmvc {
 
 class ModelObserver;
+class Model;
+
+/**
+ * Something computed from models, such as a DerivedModel, that needs to
+ * know when the models it read change.
+ */
+class ModelDependent
+{
+    public:
+        /**
+         * Called when a model this depends on has changed.  Only mark the
+         * dependent stale here and pass the change on; observers are told
+         * from invalidated(), once everything the change reaches is stale.
+         *
+         * @return  True if the dependent was not already stale.
+         */
+        virtual bool invalidate() = 0;
+
+        /**
+         * Called after a change has been passed on to everything it
+         * reaches, if invalidate() returned true.
+         */
+        virtual void invalidated() {}
+
+        /**
+         * Called when a model is read while this is being computed.
+         *
+         * @param source    Model that was read.
+         */
+        virtual void depend(Model * const source) = 0;
+
+        /**
+         * Called when a model this depends on is being destroyed.
+         *
+         * @param source    Model being destroyed.
+         */
+        virtual void forget(Model * const source) = 0;
+
+    protected:
+        ModelDependent() {}
+        ~ModelDependent() {}
+
+    private:
+        DISALLOW_COPY_AND_ASSIGN(ModelDependent);
+};
 
 /**
  * Models store all domain logic and should be the interface to the main
  * portion of the application.
  */
-class Model: public SimpleSubject<Model, ModelObserver> 
+class Model: public SimpleSubject<Model, ModelObserver>, public AccountedObject<MEMORY_MODELS>
 {
     public:
         /**
-         * Empty constructor.
+         * Constructor.
+         */
+        Model():_deferring(false),_invalidating(false) {}
+
+        /**
+         * Destructor.  Lets anything computed from the model know it is
+         * gone.
+         */
+        virtual ~Model()
+        {
+            std::vector<ModelDependent *> dependents(_dependents);
+            for (std::vector<ModelDependent *>::iterator iter = dependents.begin();
+                    iter != dependents.end();
+                    iter++) {
+                (*iter)->forget(this);
+            }
+        }
+
+        typedef std::vector<Model *> InputList;
+
+        /**
+         * Get the memory used by the model.  Only meaningful for models
+         * allocated with new while memory accounting is on.  Models holding
+         * large containers may add their size.
+         *
+         * @return  Bytes used, or 0 if not accounted.
          */
-        Model() {}
+        virtual std::size_t footprint() const
+        {
+            return accountedSize();
+        }
 
         /**
-         * Empty destructor.
+         * Advance the model by one cycle of the main loop.  Models that do
+         * not depend on each other may tick at the same time on different
+         * threads, so a tick should only touch the model itself and read
+         * its inputs.  Notifications sent during a tick are delivered on
+         * the main thread afterwards.
          */
-        virtual ~Model() {}
+        virtual void tick() {}
+
+        /**
+         * Get how often the main loop must wake to tick the model even
+         * when no events arrive, for models fed from outside the process.
+         * Read when the model is attached.
+         *
+         * @return  Milliseconds between ticks, or -1 if events suffice.
+         */
+        virtual long getPollInterval() const
+        {
+            return -1;
+        }
+
+        /**
+         * Bring the model up to date before others read it from several
+         * threads at once.  Models computed lazily, such as DerivedModel,
+         * compute their value here.
+         */
+        virtual void refresh() {}
+
+        /**
+         * Get the models that must finish ticking before this one starts.
+         *
+         * @return  List of input models.
+         */
+        virtual InputList getInputs() const
+        {
+            return InputList();
+        }
+
+        /**
+         * Write the model's state to an image.  Models that can be warm
+         * started should write everything restore() needs.
+         *
+         * @param image Writer positioned at the model's section.
+         */
+        virtual void save(ImageWriter &image) const {}
+
+        /**
+         * Restore the model's state from an image written by save().  The
+         * data may be used in place; it stays mapped for the life of the
+         * facade.
+         *
+         * @param image Reader for the model's section.
+         * @return      False if the image does not hold what save() writes.
+         *              Models with nothing to restore succeed.
+         */
+        virtual bool restore(ImageReader &image)
+        {
+            return true;
+        }
+
+        /**
+         * Hold back notifications, and the invalidation of dependents,
+         * until flushNotifications() is called.
+         */
+        void deferNotifications()
+        {
+            _deferring = true;
+        }
+
+        /**
+         * Stop holding back notifications.  Invalidate dependents if the
+         * model changed meanwhile, then send the notifications held so
+         * far, in order.
+         */
+        void flushNotifications()
+        {
+            _deferring = false;
+            if (_invalidating) {
+                _invalidating = false;
+                invalidateDependents();
+            }
+            if (_deferred.empty()) return;
+            std::vector<int> events;
+            events.swap(_deferred);
+            for (std::vector<int>::iterator iter = events.begin();
+                    iter != events.end();
+                    iter++) {
+                notify(*iter);
+            }
+        }
+
+        /**
+         * Register something computed from this model.
+         *
+         * @param dependent Dependent to register.
+         */
+        void addDependent(ModelDependent * const dependent)
+        {
+            for (std::vector<ModelDependent *>::iterator iter = _dependents.begin();
+                    iter != _dependents.end();
+                    iter++) {
+                if ((*iter) == dependent) return;
+            }
+            _dependents.push_back(dependent);
+        }
+
+        /**
+         * Unregister something computed from this model.
+         *
+         * @param dependent Dependent to unregister.
+         */
+        void removeDependent(ModelDependent * const dependent)
+        {
+            for (std::vector<ModelDependent *>::iterator iter = _dependents.begin();
+                    iter != _dependents.end();
+                    iter++) {
+                if ((*iter) == dependent) {
+                    _dependents.erase(iter);
+                    return;
+                }
+            }
+        }
+
+        /**
+         * Start a batch of changes.  Dependents reached by any of them are
+         * told once, when the matching endChanges() is called.  Batches
+         * nest.
+         */
+        static void beginChanges()
+        {
+            wave().depth++;
+        }
+
+        /**
+         * End a batch of changes started by beginChanges().
+         */
+        static void endChanges()
+        {
+            Wave &current = wave();
+            if (--current.depth > 0) return;
+            DependentList marked;
+            marked.swap(current.marked);
+            for (DependentList::iterator iter = marked.begin();
+                    iter != marked.end();
+                    iter++) {
+                (*iter)->invalidated();
+            }
+        }
+
+        /**
+         * Get or set what is being computed on this thread, so models read
+         * during the computation can be recorded as its dependencies.
+         *
+         * @return  Reference to the dependent being computed, or NULL.
+         */
+        static ModelDependent *&evaluating()
+        {
+            static thread_local ModelDependent *dependent = 0;
+            return dependent;
+        }
+
+        /**
+         * Get the current version of the model.  It goes up with every
+         * recorded change.
+         *
+         * @return  Current version.
+         */
+        unsigned long getVersion() const
+        {
+            return _journal.getVersion();
+        }
+
+        /**
+         * Get the version at which a property last changed.
+         *
+         * @param property  Property to look up.
+         * @return          Version, or 0 if it never changed.
+         */
+        unsigned long getVersion(int property) const
+        {
+            return _journal.getVersion(property);
+        }
+
+        /**
+         * Get what changed after a version.
+         *
+         * @param version   Version already seen by the caller.
+         * @param changes   Receives the changes, in order.
+         * @return          False if the changes are no longer known and
+         *                  the caller should re-read the whole model.
+         */
+        bool changesSince(unsigned long version, ChangeList &changes) const
+        {
+            return _journal.changesSince(version, changes);
+        }
+
+    protected:
+        /**
+         * Notify observers, or hold the event back while notifications are
+         * deferred.
+         *
+         * @param event Event type to notify observers of.
+         */
+        virtual void notify(int event)
+        {
+            if (_deferring) {
+                _deferred.push_back(event);
+                return;
+            }
+            SimpleSubject<Model, ModelObserver>::notify(event);
+        }
+
+        /**
+         * Note that the model is being read.  Accessors should call this so
+         * that anything computed from them tracks the model automatically.
+         */
+        void read() const
+        {
+            ModelDependent *dependent = evaluating();
+            if (dependent) dependent->depend(const_cast<Model *>(this));
+        }
+
+        /**
+         * Mark everything computed from the model as stale.  The change
+         * recording functions below call this.  Dependents only hear about
+         * it once the whole change has spread, so none of them can see
+         * some of its sources updated and others not.  While notifications
+         * are deferred, as during a tick, this is put off until they are
+         * flushed on the main thread.
+         */
+        void invalidateDependents()
+        {
+            if (_dependents.empty()) return;
+            if (_deferring) {
+                _invalidating = true;
+                return;
+            }
+            std::vector<ModelDependent *> dependents(_dependents);
+            spread(dependents);
+        }
+
+        /**
+         * Mark one dependent stale as if one of its sources had changed.
+         *
+         * @param dependent Dependent to invalidate.
+         */
+        static void invalidateDependent(ModelDependent * const dependent)
+        {
+            spread(std::vector<ModelDependent *>(1, dependent));
+        }
+
+        /**
+         * Record that a property changed.
+         *
+         * @param property  Property that changed.
+         * @return          The new version.
+         */
+        unsigned long changed(int property)
+        {
+            unsigned long version = _journal.record(Change::PROPERTY, property, 0);
+            invalidateDependents();
+            return version;
+        }
+
+        /**
+         * Record that elements were inserted.
+         *
+         * @param first Index of the first inserted element.
+         * @param count Number of elements inserted.
+         * @return      The new version.
+         */
+        unsigned long inserted(unsigned int first, unsigned int count = 1)
+        {
+            unsigned long version = _journal.record(Change::INSERTED, first, count);
+            invalidateDependents();
+            return version;
+        }
+
+        /**
+         * Record that elements were removed.
+         *
+         * @param first Index of the first removed element.
+         * @param count Number of elements removed.
+         * @return      The new version.
+         */
+        unsigned long removed(unsigned int first, unsigned int count = 1)
+        {
+            unsigned long version = _journal.record(Change::REMOVED, first, count);
+            invalidateDependents();
+            return version;
+        }
+
+        /**
+         * Record that elements were updated in place.
+         *
+         * @param first Index of the first updated element.
+         * @param count Number of elements updated.
+         * @return      The new version.
+         */
+        unsigned long updated(unsigned int first, unsigned int count = 1)
+        {
+            unsigned long version = _journal.record(Change::UPDATED, first, count);
+            invalidateDependents();
+            return version;
+        }
 
     private:
+        typedef std::vector<ModelDependent *> DependentList;
+
+        /**
+         * Dependents marked stale by the change being spread on this
+         * thread.
+         */
+        struct Wave
+        {
+            Wave():depth(0) {}
+            unsigned int depth;
+            DependentList marked;
+        };
+
+        static Wave &wave()
+        {
+            static thread_local Wave wave;
+            return wave;
+        }
+
+        /**
+         * Invalidate dependents, and once the outermost call has marked
+         * everything reachable, tell the marked ones in the order they
+         * were reached.
+         */
+        static void spread(const DependentList &dependents)
+        {
+            beginChanges();
+            for (DependentList::const_iterator iter = dependents.begin();
+                    iter != dependents.end();
+                    iter++) {
+                if ((*iter)->invalidate()) wave().marked.push_back(*iter);
+            }
+            endChanges();
+        }
+
+        ChangeJournal _journal;
+        std::vector<ModelDependent *> _dependents;
+        bool _deferring;
+        bool _invalidating;
+        std::vector<int> _deferred;
+
         DISALLOW_COPY_AND_ASSIGN(Model);
 };
 
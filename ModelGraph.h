@@ -0,0 +1,251 @@
+/**
+ * Copyright (c) 2008 Christopher Allen Ogden
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef SYD_FRAMEWORK_MODELGRAPH_H_
+#define SYD_FRAMEWORK_MODELGRAPH_H_
+
+#include <vector>
+#include <map>
+#include <set>
+#include "Model.h"
+#include "ThreadPool.h"
+
+namespace sydmvc {
+
+/**
+ * Ticks a set of models in dependency order.  Models are grouped into
+ * waves so that every model's inputs are in earlier waves; the models of
+ * a wave tick in parallel on a thread pool.  Each model's notifications
+ * are held back during its wave, as is the invalidation of whatever is
+ * computed from it, and both happen on the calling thread once the wave
+ * has finished.  Models caught in an input cycle tick one at a
+ * time after the rest.
+ *
+ * Before a wave ticks, the inputs its models declare are refreshed on the
+ * calling thread, so a stale DerivedModel read by several models of the
+ * wave is recomputed once, up front, rather than by each of them at the
+ * same time.  Models must therefore list every derived model they read
+ * in getInputs().
+ */
+class ModelGraph: public ParallelJob
+{
+    public:
+        ModelGraph():_dirty(false),_wave(NULL),_pollInterval(-1) {}
+
+        /**
+         * Add a model.
+         *
+         * @param model Model to add.
+         */
+        void add(Model * const model)
+        {
+            _models.push_back(model);
+            _dirty = true;
+            long interval = model->getPollInterval();
+            if (interval >= 0 && (_pollInterval < 0 || interval < _pollInterval)) {
+                _pollInterval = interval;
+            }
+        }
+
+        /**
+         * Remove a model.
+         *
+         * @param model Model to remove.
+         */
+        void remove(Model * const model)
+        {
+            for (Model::InputList::iterator iter = _models.begin();
+                    iter != _models.end();
+                    iter++) {
+                if ((*iter) == model) {
+                    _models.erase(iter);
+                    _dirty = true;
+                    break;
+                }
+            }
+            _pollInterval = -1;
+            for (Model::InputList::iterator iter = _models.begin();
+                    iter != _models.end();
+                    iter++) {
+                long interval = (*iter)->getPollInterval();
+                if (interval >= 0 && (_pollInterval < 0 || interval < _pollInterval)) {
+                    _pollInterval = interval;
+                }
+            }
+        }
+
+        /**
+         * Get the shortest poll interval of the models.
+         *
+         * @return  Milliseconds, or -1 if no model needs polling.
+         */
+        long getPollInterval() const
+        {
+            return _pollInterval;
+        }
+
+        /**
+         * Recompute the waves on the next tick, for instance after a model
+         * changed its inputs.
+         */
+        void invalidate()
+        {
+            _dirty = true;
+        }
+
+        /**
+         * Tick every model.
+         *
+         * @param pool  Pool to tick models on, or NULL to tick them all on
+         *              the calling thread.
+         */
+        void tick(ThreadPool * const pool)
+        {
+            if (_dirty) build();
+            for (WaveList::iterator wave = _waves.begin();
+                    wave != _waves.end();
+                    wave++) {
+                Model::InputList &inputs = _inputs[wave - _waves.begin()];
+                for (Model::InputList::iterator iter = inputs.begin();
+                        iter != inputs.end();
+                        iter++) {
+                    (*iter)->refresh();
+                }
+                for (Model::InputList::iterator iter = wave->begin();
+                        iter != wave->end();
+                        iter++) {
+                    (*iter)->deferNotifications();
+                }
+                if (pool) {
+                    _wave = &(*wave);
+                    pool->run(this, wave->size());
+                    _wave = NULL;
+                } else {
+                    for (Model::InputList::iterator iter = wave->begin();
+                            iter != wave->end();
+                            iter++) {
+                        (*iter)->tick();
+                    }
+                }
+                Model::beginChanges();
+                for (Model::InputList::iterator iter = wave->begin();
+                        iter != wave->end();
+                        iter++) {
+                    (*iter)->flushNotifications();
+                }
+                Model::endChanges();
+            }
+        }
+
+        virtual void run(unsigned int index)
+        {
+            (*_wave)[index]->tick();
+        }
+
+    private:
+        typedef std::vector<Model::InputList> WaveList;
+
+        /**
+         * Sort the models into waves.
+         */
+        void build()
+        {
+            std::map<Model *, unsigned int> pending;
+            std::map<Model *, Model::InputList> users;
+            for (Model::InputList::iterator iter = _models.begin();
+                    iter != _models.end();
+                    iter++) {
+                pending[*iter] = 0;
+            }
+            for (Model::InputList::iterator iter = _models.begin();
+                    iter != _models.end();
+                    iter++) {
+                Model::InputList inputs = (*iter)->getInputs();
+                for (Model::InputList::iterator input = inputs.begin();
+                        input != inputs.end();
+                        input++) {
+                    if ((*input) == (*iter) || pending.find(*input) == pending.end()) continue;
+                    pending[*iter]++;
+                    users[*input].push_back(*iter);
+                }
+            }
+            _waves.clear();
+            Model::InputList ready;
+            for (Model::InputList::iterator iter = _models.begin();
+                    iter != _models.end();
+                    iter++) {
+                if (pending[*iter] == 0) ready.push_back(*iter);
+            }
+            unsigned int placed = 0;
+            while (!ready.empty()) {
+                _waves.push_back(ready);
+                placed += ready.size();
+                Model::InputList next;
+                for (Model::InputList::iterator iter = ready.begin();
+                        iter != ready.end();
+                        iter++) {
+                    Model::InputList &list = users[*iter];
+                    for (Model::InputList::iterator user = list.begin();
+                            user != list.end();
+                            user++) {
+                        if (--pending[*user] == 0) next.push_back(*user);
+                    }
+                }
+                ready.swap(next);
+            }
+            if (placed < _models.size()) {
+                for (Model::InputList::iterator iter = _models.begin();
+                        iter != _models.end();
+                        iter++) {
+                    if (pending[*iter] > 0) _waves.push_back(Model::InputList(1, *iter));
+                }
+            }
+            _inputs.assign(_waves.size(), Model::InputList());
+            for (unsigned int i = 0; i < _waves.size(); i++) {
+                std::set<Model *> seen;
+                for (Model::InputList::iterator iter = _waves[i].begin();
+                        iter != _waves[i].end();
+                        iter++) {
+                    Model::InputList inputs = (*iter)->getInputs();
+                    for (Model::InputList::iterator input = inputs.begin();
+                            input != inputs.end();
+                            input++) {
+                        if (seen.insert(*input).second) _inputs[i].push_back(*input);
+                    }
+                }
+            }
+            _dirty = false;
+        }
+
+        Model::InputList _models;
+        WaveList _waves;
+        WaveList _inputs;
+        bool _dirty;
+        Model::InputList *_wave;
+        long _pollInterval;
+
+        DISALLOW_COPY_AND_ASSIGN(ModelGraph);
+};
+
+}
+
+#endif
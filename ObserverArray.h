@@ -0,0 +1,187 @@
+/**
+ * Copyright (c) 2008 Christopher Allen Ogden
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef SYD_FRAMEWORK_OBSERVERARRAY_H_
+#define SYD_FRAMEWORK_OBSERVERARRAY_H_
+
+#include <cstddef>
+#include <vector>
+#include "ObserverGroup.h"
+#include "MemoryAccounting.h"
+
+namespace sydmvc {
+
+/**
+ * Many observers of one kind, with their state in one contiguous block.
+ * Each observer is a Member, subscribed to subjects like any other
+ * observer; a simple subject notifying a run of members hands the whole
+ * run to batch() at once, which can then run as a plain loop the compiler
+ * is free to vectorize.  O is the observer base the subject expects, such
+ * as Observer or ModelObserver.
+ *
+ * Subjects other than SimpleSubject, or members that are not next to each
+ * other in the subject's list, fall back to one update() per member,
+ * which calls batch() for that member alone.
+ *
+ * A member keeps its index for as long as it lives.  Removing one leaves
+ * a hole in the block, which the next member added fills; batch() is
+ * never handed the state of a hole, as no subject has it subscribed.
+ * Members must be detached from their subjects before they are removed.
+ */
+template <class O, class State>
+class ObserverArray: public ObserverGroup
+{
+    public:
+        typedef std::vector<State, AccountedAllocator<State, MEMORY_OBSERVERS> > StateList;
+
+        /**
+         * An observer in the array.
+         */
+        class Member: public O, public GroupMember, public AccountedObject<MEMORY_OBSERVERS>
+        {
+            public:
+                virtual void update(int event)
+                {
+                    getGroup()->updateMembers(event, getIndex(), 1);
+                }
+
+            private:
+                friend class ObserverArray;
+
+                Member(ObserverArray *array, std::size_t index):GroupMember(array, index) {}
+                virtual ~Member() {}
+
+                DISALLOW_COPY_AND_ASSIGN(Member);
+        };
+
+        /**
+         * Add an observer.
+         *
+         * @param state Its initial state.
+         * @return      The observer, owned by the array.
+         */
+        Member *add(const State &state)
+        {
+            std::size_t index;
+            if (_free.empty()) {
+                index = _members.size();
+                _states.push_back(state);
+                _members.push_back(NULL);
+            } else {
+                index = _free.back();
+                _free.pop_back();
+                _states[index] = state;
+            }
+            _members[index] = new Member(this, index);
+            return _members[index];
+        }
+
+        /**
+         * Remove an observer.  It must not be subscribed to any subject.
+         *
+         * @param member    The observer.
+         */
+        void remove(Member *member)
+        {
+            std::size_t index = member->getIndex();
+            _members[index] = NULL;
+            _free.push_back(index);
+            delete member;
+        }
+
+        /**
+         * Get an observer's state.
+         *
+         * @param member    The observer.
+         * @return          Its state.
+         */
+        State &at(const Member *member)
+        {
+            return _states[member->getIndex()];
+        }
+
+        const State &at(const Member *member) const
+        {
+            return _states[member->getIndex()];
+        }
+
+        /**
+         * Get the number of observers.
+         *
+         * @return  Number of observers.
+         */
+        std::size_t size() const
+        {
+            return _members.size() - _free.size();
+        }
+
+        /**
+         * Reserve room for observers ahead of time.
+         *
+         * @param count Number of observers.
+         */
+        void reserve(std::size_t count)
+        {
+            _states.reserve(count);
+            _members.reserve(count);
+        }
+
+        virtual void updateMembers(int event, std::size_t first, std::size_t count)
+        {
+            batch(event, &_states[first], count);
+        }
+
+    protected:
+        ObserverArray() {}
+
+        virtual ~ObserverArray()
+        {
+            for (typename MemberList::iterator iter = _members.begin();
+                    iter != _members.end();
+                    iter++) {
+                if (*iter) delete (*iter);
+            }
+        }
+
+        /**
+         * Update a run of observers.
+         *
+         * @param event Event type triggering the update.
+         * @param begin First observer's state.
+         * @param count Number of observers.
+         */
+        virtual void batch(int event, State *begin, std::size_t count) = 0;
+
+    private:
+        typedef std::vector<Member *, AccountedAllocator<Member *, MEMORY_OBSERVERS> > MemberList;
+        typedef std::vector<std::size_t, AccountedAllocator<std::size_t, MEMORY_OBSERVERS> > IndexList;
+
+        StateList _states;
+        MemberList _members;
+        IndexList _free;
+
+        DISALLOW_COPY_AND_ASSIGN(ObserverArray);
+};
+
+}
+
+#endif
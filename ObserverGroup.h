@@ -0,0 +1,98 @@
+/**
+ * Copyright (c) 2008 Christopher Allen Ogden
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef SYD_FRAMEWORK_OBSERVERGROUP_H_
+#define SYD_FRAMEWORK_OBSERVERGROUP_H_
+
+#include <cstddef>
+#include "macros.h"
+
+namespace sydmvc {
+
+/**
+ * A group of observers of one kind whose state is kept side by side, so
+ * an event can be handled for a run of them in one call.  See
+ * ObserverArray.
+ */
+class ObserverGroup
+{
+    public:
+        /**
+         * Called by the subject for a run of members subscribed to the
+         * event, in place of their update().
+         *
+         * @param event Event type triggering the update.
+         * @param first Index of the first member.
+         * @param count Number of members, with consecutive indices.
+         */
+        virtual void updateMembers(int event, std::size_t first, std::size_t count) = 0;
+
+    protected:
+        ObserverGroup() {}
+        virtual ~ObserverGroup() {}
+
+    private:
+        DISALLOW_COPY_AND_ASSIGN(ObserverGroup);
+};
+
+/**
+ * Opt-in interface for observers that belong to a group.  A simple subject
+ * spots it when the observer subscribes and, when notifying, hands runs of
+ * members of the same group with consecutive indices to the group as a
+ * whole.  A member's group and index never change.
+ */
+class GroupMember
+{
+    public:
+        /**
+         * Get the group.
+         *
+         * @return  The group the member belongs to.
+         */
+        ObserverGroup *getGroup() const
+        {
+            return _group;
+        }
+
+        /**
+         * Get the member's index in its group.
+         *
+         * @return  Its index.
+         */
+        std::size_t getIndex() const
+        {
+            return _index;
+        }
+
+    protected:
+        GroupMember(ObserverGroup *group, std::size_t index):_group(group),_index(index) {}
+        ~GroupMember() {}
+
+    private:
+        ObserverGroup * const _group;
+        const std::size_t _index;
+        DISALLOW_COPY_AND_ASSIGN(GroupMember);
+};
+
+}
+
+#endif
@@ -0,0 +1,213 @@
+/**
+ * Copyright (c) 2008 Christopher Allen Ogden
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef SYD_FRAMEWORK_PERSISTENTVECTOR_H_
+#define SYD_FRAMEWORK_PERSISTENTVECTOR_H_
+
+#include <vector>
+#include <memory>
+
+namespace sydmvc {
+
+/**
+ * An immutable vector with structural sharing.  Elements live in the
+ * leaves of a 32-way trie; every change copies only the nodes on the path
+ * to the changed element and shares the rest with the original, so old
+ * versions stay valid and cheap to keep around.  Copying a vector is O(1),
+ * and get, set, push_back and pop_back are O(log32 n).
+ *
+ * A vector is safe to read from any number of threads at once.
+ */
+template <class T>
+class PersistentVector
+{
+    public:
+        /**
+         * Construct an empty vector.
+         */
+        PersistentVector():_size(0),_shift(0) {}
+
+        /**
+         * Get the number of elements.
+         *
+         * @return  Number of elements.
+         */
+        unsigned int size() const
+        {
+            return _size;
+        }
+
+        /**
+         * Check whether the vector is empty.
+         *
+         * @return  True if there are no elements.
+         */
+        bool empty() const
+        {
+            return _size == 0;
+        }
+
+        /**
+         * Get an element.
+         *
+         * @param index Index of the element; must be less than size().
+         * @return      The element.
+         */
+        const T &get(unsigned int index) const
+        {
+            const Node *node = _root.get();
+            for (unsigned int level = _shift; level > 0; level -= BITS) {
+                node = node->children[(index >> level) & MASK].get();
+            }
+            return node->values[index & MASK];
+        }
+
+        const T &operator[](unsigned int index) const
+        {
+            return get(index);
+        }
+
+        /**
+         * Get a copy with one element replaced.
+         *
+         * @param index Index of the element; must be less than size().
+         * @param value New value.
+         * @return      The new vector.
+         */
+        PersistentVector set(unsigned int index, const T &value) const
+        {
+            PersistentVector result(*this);
+            result._root = setIn(_root, _shift, index, value);
+            return result;
+        }
+
+        /**
+         * Get a copy with an element appended.
+         *
+         * @param value Value to append.
+         * @return      The new vector.
+         */
+        PersistentVector push_back(const T &value) const
+        {
+            PersistentVector result(*this);
+            if (_root && (_size >> BITS) >= (1u << _shift)) {
+                std::shared_ptr<Node> root(new Node());
+                root->children.push_back(_root);
+                root->children.push_back(pushIn(NodePtr(), _shift, _size, value));
+                result._root = root;
+                result._shift = _shift + BITS;
+            } else {
+                result._root = pushIn(_root, _shift, _size, value);
+            }
+            result._size++;
+            return result;
+        }
+
+        /**
+         * Get a copy with the last element removed.
+         *
+         * @return  The new vector; must not be called on an empty one.
+         */
+        PersistentVector pop_back() const
+        {
+            PersistentVector result(*this);
+            result._root = popIn(_root, _shift, _size - 1);
+            result._size--;
+            while (result._shift > 0 && result._root->children.size() == 1) {
+                result._root = result._root->children[0];
+                result._shift -= BITS;
+            }
+            return result;
+        }
+
+    private:
+        enum { BITS = 5, BRANCH = 1 << BITS, MASK = BRANCH - 1 };
+
+        struct Node;
+        typedef std::shared_ptr<const Node> NodePtr;
+
+        /**
+         * Inner nodes have children, leaves have values.
+         */
+        struct Node
+        {
+            std::vector<NodePtr> children;
+            std::vector<T> values;
+        };
+
+        static NodePtr setIn(const NodePtr &node, unsigned int level, unsigned int index,
+                const T &value)
+        {
+            std::shared_ptr<Node> copy(new Node(*node));
+            if (level == 0) {
+                copy->values[index & MASK] = value;
+            } else {
+                unsigned int child = (index >> level) & MASK;
+                copy->children[child] = setIn(node->children[child], level - BITS, index, value);
+            }
+            return copy;
+        }
+
+        static NodePtr pushIn(const NodePtr &node, unsigned int level, unsigned int index,
+                const T &value)
+        {
+            std::shared_ptr<Node> copy(node ? new Node(*node) : new Node());
+            if (level == 0) {
+                copy->values.push_back(value);
+            } else {
+                unsigned int child = (index >> level) & MASK;
+                if (child < copy->children.size()) {
+                    copy->children[child] = pushIn(copy->children[child], level - BITS, index, value);
+                } else {
+                    copy->children.push_back(pushIn(NodePtr(), level - BITS, index, value));
+                }
+            }
+            return copy;
+        }
+
+        static NodePtr popIn(const NodePtr &node, unsigned int level, unsigned int index)
+        {
+            std::shared_ptr<Node> copy(new Node(*node));
+            if (level == 0) {
+                copy->values.pop_back();
+                if (copy->values.empty()) return NodePtr();
+            } else {
+                unsigned int child = (index >> level) & MASK;
+                NodePtr popped = popIn(copy->children[child], level - BITS, index);
+                if (popped) {
+                    copy->children[child] = popped;
+                } else {
+                    copy->children.pop_back();
+                    if (copy->children.empty()) return NodePtr();
+                }
+            }
+            return copy;
+        }
+
+        NodePtr _root;
+        unsigned int _size;
+        unsigned int _shift;
+};
+
+}
+
+#endif
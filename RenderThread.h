@@ -0,0 +1,146 @@
+/**
+ * Copyright (c) 2008 Christopher Allen Ogden
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef SYD_FRAMEWORK_RENDERTHREAD_H_
+#define SYD_FRAMEWORK_RENDERTHREAD_H_
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "BufferedState.h"
+#include "ViewObject.h"
+
+namespace sydmvc {
+
+template <class I> class System;
+
+/**
+ * Draws a view on a thread of its own.  Each time the facade finishes a
+ * frame, the render thread acquires the published state and draws the
+ * view against it while the logic thread carries on with the next frame.
+ * Frames published faster than they can be drawn are skipped.
+ *
+ * Views drawn this way must only read model state through buffers in the
+ * set, and the system must allow drawing from this thread.  The view tree
+ * itself is shared with the logic thread: the render thread holds the
+ * tree lock while drawing, and ViewComposite takes the same lock to add,
+ * remove or compact children, so the tree may change between frames but
+ * never while it is being walked.  Other changes to a view's own fields
+ * must go through buffers like model state.
+ */
+template <class I>
+class RenderThread
+{
+    public:
+        /**
+         * Constructor.  Starts the thread.
+         *
+         * @param view      View to draw, usually the root ViewComposite.
+         * @param system    System to draw with.
+         * @param buffers   Buffers to acquire before each frame.
+         * @param tree      Lock guarding the shape of the view tree.
+         */
+        RenderThread(ViewObject<I> * const view, System<I> * const system,
+                StateBufferSet * const buffers, std::mutex * const tree)
+            :_view(view),_system(system),_buffers(buffers),_tree(tree),
+             _published(0),_drawn(0),_stop(false)
+        {
+            _thread = std::thread(&RenderThread::main, this);
+        }
+
+        /**
+         * Destructor.  Finishes the frame being drawn and stops the thread.
+         */
+        virtual ~RenderThread()
+        {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _stop = true;
+            }
+            _wake.notify_one();
+            _thread.join();
+        }
+
+        /**
+         * Signal that a frame has been published.  Logic thread only.
+         */
+        void signal()
+        {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _published++;
+            }
+            _wake.notify_one();
+        }
+
+        /**
+         * Get the number of frames drawn so far.
+         *
+         * @return  Frames drawn.
+         */
+        unsigned long getFramesDrawn() const
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            return _drawn;
+        }
+
+    private:
+        /**
+         * Body of the render thread.
+         */
+        void main()
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            while (true) {
+                while (!_stop && _published == _drawn) {
+                    _wake.wait(lock);
+                }
+                if (_stop) break;
+                unsigned long frame = _published;
+                lock.unlock();
+                _buffers->acquire();
+                {
+                    std::lock_guard<std::mutex> tree(*_tree);
+                    _view->draw(_system);
+                }
+                lock.lock();
+                _drawn = frame;
+            }
+        }
+
+        ViewObject<I> *_view;
+        System<I> *_system;
+        StateBufferSet *_buffers;
+        std::mutex *_tree;
+        unsigned long _published;
+        unsigned long _drawn;
+        bool _stop;
+        mutable std::mutex _mutex;
+        std::condition_variable _wake;
+        std::thread _thread;
+
+        DISALLOW_COPY_AND_ASSIGN(RenderThread);
+};
+
+}
+
+#endif
@@ -0,0 +1,356 @@
+/**
+ * Copyright (c) 2008 Christopher Allen Ogden
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef SYD_FRAMEWORK_SHARDEDFACADE_H_
+#define SYD_FRAMEWORK_SHARDEDFACADE_H_
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+#include "Channel.h"
+
+namespace sydmvc {
+
+/**
+ * A message between shards.
+ */
+class ShardMessage
+{
+    public:
+        ShardMessage():key(0),event(0),data(NULL) {}
+        ShardMessage(int k, int e, void *d):key(k),event(e),data(d) {}
+
+        int key;
+        int event;
+        void *data;
+};
+
+template <class F> class ShardedFacade;
+
+/**
+ * One event loop of a sharded facade.  It is the user's facade with its
+ * own system, controllers, models and views, plus an inbox that is
+ * drained once per cycle and delivered through Facade::receive().
+ */
+template <class F>
+class Shard: public F
+{
+    public:
+        /**
+         * Drain the inbox, then do the facade's own idle work.
+         */
+        virtual void idle(void)
+        {
+            _sleeping.store(false);
+            if (_stop.load()) this->quit();
+            _owner->drain(_index);
+            F::idle();
+        }
+
+        /**
+         * Ask the shard to stop.  Safe to call from any thread.
+         */
+        void stop()
+        {
+            _stop.store(true);
+            wake();
+        }
+
+        /**
+         * Wake the shard if it is waiting for events.  Safe to call from any
+         * thread.
+         */
+        void wake()
+        {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (_sleeping.load() && this->getSystem()) this->getSystem()->wake();
+        }
+
+    protected:
+        /**
+         * Do not wait for events while messages are waiting.
+         */
+        virtual long nextTimeout() const
+        {
+            _sleeping.store(true);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (_stop.load() || !_owner->idle(_index)) return 0;
+            return F::nextTimeout();
+        }
+
+    private:
+        friend class ShardedFacade<F>;
+
+        Shard(ShardedFacade<F> * const owner, unsigned int index)
+            :_owner(owner),_index(index),_stop(false),_sleeping(false) {}
+
+        ShardedFacade<F> *_owner;
+        unsigned int _index;
+        std::atomic<bool> _stop;
+        mutable std::atomic<bool> _sleeping;
+};
+
+/**
+ * Runs several instances of a facade, each on its own thread pinned to a
+ * core.  Every shard keeps the usual single-threaded semantics; shards
+ * only talk to each other through messages, which are routed by key and
+ * carried over lock-free single-producer channels, one per pair of
+ * shards plus one from the outside.  Messages from outside the shards
+ * must come from a single thread.
+ *
+ * F must be a default-constructible Facade subclass.  Messages arrive
+ * through its receive() method.
+ */
+template <class F>
+class ShardedFacade
+{
+    public:
+        /**
+         * Constructor.
+         *
+         * @param shards    Number of shards; zero means one per core.
+         * @param capacity  Capacity of each channel, in messages.
+         */
+        ShardedFacade(unsigned int shards = 0, unsigned int capacity = 1024)
+        {
+            if (shards == 0) shards = std::thread::hardware_concurrency();
+            if (shards == 0) shards = 1;
+            for (unsigned int i = 0; i < shards; i++) {
+                _shards.push_back(new Shard<F>(this, i));
+            }
+            for (unsigned int i = 0; i < (shards + 1) * shards; i++) {
+                _channels.push_back(new Channel<ShardMessage>(capacity));
+            }
+        }
+
+        /**
+         * Destructor.  Stops the shards if they are running.
+         */
+        virtual ~ShardedFacade()
+        {
+            quit();
+            join();
+            for (typename ShardList::iterator iter = _shards.begin();
+                    iter != _shards.end();
+                    iter++) {
+                delete (*iter);
+            }
+            for (typename ChannelList::iterator iter = _channels.begin();
+                    iter != _channels.end();
+                    iter++) {
+                delete (*iter);
+            }
+        }
+
+        /**
+         * Start every shard on its own thread.  Each shard is initialized on
+         * its thread before entering its main loop.
+         */
+        virtual void start()
+        {
+            unsigned int cores = std::thread::hardware_concurrency();
+            for (unsigned int i = 0; i < _shards.size(); i++) {
+                _threads.push_back(std::thread(&ShardedFacade::main, this, i));
+                if (cores) pin(_threads.back(), i % cores);
+            }
+        }
+
+        /**
+         * Wait for every shard to stop.
+         */
+        virtual void join()
+        {
+            for (std::vector<std::thread>::iterator iter = _threads.begin();
+                    iter != _threads.end();
+                    iter++) {
+                if (iter->joinable()) iter->join();
+            }
+            _threads.clear();
+        }
+
+        /**
+         * Start the shards and wait for them to stop.
+         */
+        virtual void run()
+        {
+            start();
+            join();
+        }
+
+        /**
+         * Ask every shard to stop.
+         */
+        virtual void quit()
+        {
+            for (typename ShardList::iterator iter = _shards.begin();
+                    iter != _shards.end();
+                    iter++) {
+                (*iter)->stop();
+            }
+        }
+
+        /**
+         * Send a message to the shard owning a key.  May be called from the
+         * shards themselves or from one outside thread.  Waits while the
+         * channel is full; a shard keeps draining its own inbox meanwhile,
+         * so shards sending to themselves or to each other cannot
+         * deadlock, but its receive() may then run from within send().
+         *
+         * @param key   Routing key.
+         * @param event Event type.
+         * @param data  Payload, handed over to the receiver.
+         */
+        void send(int key, int event, void *data = NULL)
+        {
+            unsigned int to = route(key);
+            Channel<ShardMessage> *channel = _channels[from() * _shards.size() + to];
+            ShardMessage message(key, event, data);
+            while (!channel->push(message)) {
+                _shards[to]->wake();
+                if (from() < _shards.size()) drain(from());
+                std::this_thread::yield();
+            }
+            _shards[to]->wake();
+        }
+
+        /**
+         * Get the shard owning a key.
+         *
+         * @param key   Routing key.
+         * @return      Index of the shard.
+         */
+        virtual unsigned int route(int key) const
+        {
+            return (unsigned int)key % _shards.size();
+        }
+
+        /**
+         * Get a shard.  Only touch it from its own thread once started.
+         *
+         * @param index Index of the shard.
+         * @return      The shard.
+         */
+        F *getShard(unsigned int index) const
+        {
+            return _shards[index];
+        }
+
+        /**
+         * Get the number of shards.
+         *
+         * @return  Number of shards.
+         */
+        unsigned int size() const
+        {
+            return _shards.size();
+        }
+
+    private:
+        friend class Shard<F>;
+        typedef std::vector<Shard<F> *> ShardList;
+        typedef std::vector<Channel<ShardMessage> *> ChannelList;
+
+        /**
+         * Body of a shard's thread.
+         */
+        void main(unsigned int index)
+        {
+            current() = this;
+            currentIndex() = index;
+            _shards[index]->init();
+            _shards[index]->run();
+            current() = NULL;
+        }
+
+        /**
+         * Deliver everything waiting for a shard.  Called on its thread.
+         */
+        void drain(unsigned int index)
+        {
+            ShardMessage message;
+            for (unsigned int from = 0; from <= _shards.size(); from++) {
+                Channel<ShardMessage> *channel = _channels[from * _shards.size() + index];
+                while (channel->pop(message)) {
+                    _shards[index]->receive(message.key, message.event, message.data);
+                }
+            }
+        }
+
+        /**
+         * Check whether nothing is waiting for a shard.
+         */
+        bool idle(unsigned int index) const
+        {
+            for (unsigned int from = 0; from <= _shards.size(); from++) {
+                if (!_channels[from * _shards.size() + index]->empty()) return false;
+            }
+            return true;
+        }
+
+        /**
+         * Row of the channel matrix used by the calling thread.  Threads
+         * outside the shards share the last row.
+         */
+        unsigned int from() const
+        {
+            return current() == this ? currentIndex() : _shards.size();
+        }
+
+        static const ShardedFacade *&current()
+        {
+            static thread_local const ShardedFacade *owner = NULL;
+            return owner;
+        }
+
+        static unsigned int &currentIndex()
+        {
+            static thread_local unsigned int index = 0;
+            return index;
+        }
+
+        /**
+         * Pin a thread to a core, where the platform supports it.
+         */
+        static void pin(std::thread &thread, unsigned int core)
+        {
+#ifdef __linux__
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(core, &set);
+            pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+#endif
+        }
+
+        ShardList _shards;
+        ChannelList _channels;
+        std::vector<std::thread> _threads;
+
+        DISALLOW_COPY_AND_ASSIGN(ShardedFacade);
+};
+
+}
+
+#endif
@@ -0,0 +1,468 @@
+/**
+ * Copyright (c) 2008 Christopher Allen Ogden
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef SYD_FRAMEWORK_SHAREDMODEL_H_
+#define SYD_FRAMEWORK_SHAREDMODEL_H_
+
+#include <cstddef>
+#include <cstring>
+#include <atomic>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+#include "Model.h"
+
+namespace sydmvc {
+
+/**
+ * Layout of a shared-memory region holding a model's state and its
+ * notifications.  The state is double buffered: the publisher writes the
+ * buffer readers are not pointed at, then points them at it.  Each buffer
+ * has a sequence number that is odd while it is being written, so readers
+ * can use the state in place and check afterwards that it did not change
+ * under them.  Notifications go through a ring that readers follow at
+ * their own pace.
+ */
+template <class T>
+class SharedRegion
+{
+    public:
+#if !defined(__GNUC__) || __GNUC__ >= 5
+        static_assert(std::is_trivially_copyable<T>::value, "shared state must be trivially copyable");
+#endif
+        static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2,
+                "atomics shared between processes must be lock-free");
+
+        enum { MAGIC = 0x5344534d };
+
+        struct Buffer
+        {
+            std::atomic<unsigned int> sequence;
+            T state;
+        };
+
+        struct Slot
+        {
+            std::atomic<unsigned long long> number;
+            int event;
+        };
+
+        unsigned int magic;
+        unsigned int size;
+        unsigned int capacity;
+        std::atomic<unsigned int> current;
+        std::atomic<unsigned int> wake;
+        std::atomic<unsigned long long> head;
+        Buffer buffers[2];
+
+        /**
+         * Get the notification ring, which follows the header.
+         */
+        Slot *ring()
+        {
+            return reinterpret_cast<Slot *>(this + 1);
+        }
+
+        /**
+         * Get the size of a region.
+         *
+         * @param capacity  Number of notifications in the ring.
+         * @return          Size in bytes.
+         */
+        static std::size_t bytes(unsigned int capacity)
+        {
+            return sizeof(SharedRegion) + capacity * sizeof(Slot);
+        }
+
+        /**
+         * Wake every process waiting on the region.
+         */
+        void signal()
+        {
+            wake.fetch_add(1, std::memory_order_release);
+#ifdef __linux__
+            syscall(SYS_futex, reinterpret_cast<unsigned int *>(&wake), FUTEX_WAKE,
+                    0x7fffffff, NULL, NULL, 0);
+#endif
+        }
+
+        /**
+         * Wait until woken or until the timeout passes.
+         *
+         * @param seen      Value of the wake counter already seen.
+         * @param timeout   Milliseconds to wait at most.
+         */
+        void wait(unsigned int seen, long timeout)
+        {
+#ifdef __linux__
+            struct timespec limit;
+            limit.tv_sec = timeout / 1000;
+            limit.tv_nsec = (timeout % 1000) * 1000000;
+            syscall(SYS_futex, reinterpret_cast<unsigned int *>(&wake), FUTEX_WAIT,
+                    seen, timeout < 0 ? NULL : &limit, NULL, 0);
+#else
+            if (wake.load(std::memory_order_acquire) == seen) {
+                ::usleep(timeout < 0 || timeout > 1 ? 1000 : timeout * 1000);
+            }
+#endif
+        }
+
+    private:
+        SharedRegion();
+        DISALLOW_COPY_AND_ASSIGN(SharedRegion);
+};
+
+/**
+ * Publishes a model's state and notifications into a named POSIX
+ * shared-memory region, where models in other processes on the same host
+ * can read them without copying or serializing.  There is one publisher
+ * per region.  T must be trivially copyable and must not hold pointers.
+ */
+template <class T>
+class SharedPublisher
+{
+    public:
+        SharedPublisher():_region(NULL),_bytes(0),_next(0) {}
+
+        /**
+         * Destructor.  Unmaps and removes the region.
+         */
+        ~SharedPublisher()
+        {
+            close();
+        }
+
+        /**
+         * Create the region.
+         *
+         * @param name      Name of the region, starting with a slash.
+         * @param capacity  Number of notifications readers may fall behind
+         *                  by before missing some.
+         * @return          False if the region could not be created.
+         */
+        bool open(const char * const name, unsigned int capacity = 1024)
+        {
+            close();
+            ::shm_unlink(name);
+            int fd = ::shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+            if (fd < 0) return false;
+            std::size_t bytes = Region::bytes(capacity);
+            if (::ftruncate(fd, bytes) != 0) {
+                ::close(fd);
+                ::shm_unlink(name);
+                return false;
+            }
+            void *memory = ::mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            ::close(fd);
+            if (memory == MAP_FAILED) {
+                ::shm_unlink(name);
+                return false;
+            }
+            _region = static_cast<Region *>(memory);
+            _bytes = bytes;
+            _name = name;
+            _region->size = sizeof(T);
+            _region->capacity = capacity;
+            new (&_region->current) std::atomic<unsigned int>(0);
+            new (&_region->wake) std::atomic<unsigned int>(0);
+            new (&_region->head) std::atomic<unsigned long long>(0);
+            for (unsigned int i = 0; i < 2; i++) {
+                new (&_region->buffers[i].sequence) std::atomic<unsigned int>(0);
+            }
+            for (unsigned int i = 0; i < capacity; i++) {
+                new (&_region->ring()[i].number) std::atomic<unsigned long long>(0);
+            }
+            std::atomic_thread_fence(std::memory_order_release);
+            _region->magic = Region::MAGIC;
+            return true;
+        }
+
+        /**
+         * Unmap and remove the region.  Readers that have it mapped keep
+         * their mapping.
+         */
+        void close()
+        {
+            if (!_region) return;
+            ::munmap(_region, _bytes);
+            ::shm_unlink(_name.c_str());
+            _region = NULL;
+        }
+
+        /**
+         * Publish a new state.
+         *
+         * @param state State to publish.
+         */
+        void publish(const T &state)
+        {
+            unsigned int target = 1 - _region->current.load(std::memory_order_relaxed);
+            typename Region::Buffer &buffer = _region->buffers[target];
+            unsigned int sequence = buffer.sequence.load(std::memory_order_relaxed);
+            buffer.sequence.store(sequence + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            std::memcpy(&buffer.state, &state, sizeof(T));
+            buffer.sequence.store(sequence + 2, std::memory_order_release);
+            _region->current.store(target, std::memory_order_release);
+        }
+
+        /**
+         * Send a notification to every reader and wake them.
+         *
+         * @param event Event type.
+         */
+        void notify(int event)
+        {
+            typename Region::Slot &slot = _region->ring()[_next % _region->capacity];
+            slot.number.store(0, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            slot.event = event;
+            slot.number.store(_next + 1, std::memory_order_release);
+            _next++;
+            _region->head.store(_next, std::memory_order_release);
+            _region->signal();
+        }
+
+    private:
+        typedef SharedRegion<T> Region;
+
+        Region *_region;
+        std::size_t _bytes;
+        unsigned long long _next;
+        std::string _name;
+
+        DISALLOW_COPY_AND_ASSIGN(SharedPublisher);
+};
+
+/**
+ * A model that mirrors one published by another process.  Local observers
+ * attach to it as to any model; each tick, or each call to poll(), relays
+ * the notifications published since the last one.  The state is read in
+ * place from shared memory.
+ *
+ * The publisher's wakeups cannot be waited on together with a System's
+ * own events, so the model asks the facade to wake at least once per poll
+ * interval.  A System that has nothing else to wait for may instead block
+ * in wait() from its waitEvents().
+ */
+template <class T>
+class SharedModel: public Model
+{
+    public:
+        /**
+         * Constructor.
+         *
+         * @param interval  Milliseconds the main loop may wait before
+         *                  relaying notifications.
+         */
+        explicit SharedModel(long interval = 5)
+            :_region(NULL),_bytes(0),_seen(0),_missed(0),_interval(interval) {}
+
+        /**
+         * Destructor.  Unmaps the region.
+         */
+        virtual ~SharedModel()
+        {
+            close();
+        }
+
+        /**
+         * Map a region created by a SharedPublisher.
+         *
+         * @param name  Name of the region.
+         * @return      False if there is no such region or it does not hold
+         *              a T.
+         */
+        bool open(const char * const name)
+        {
+            close();
+            int fd = ::shm_open(name, O_RDONLY, 0);
+            if (fd < 0) return false;
+            struct stat info;
+            if (::fstat(fd, &info) != 0 || (std::size_t)info.st_size < sizeof(Region)) {
+                ::close(fd);
+                return false;
+            }
+            void *memory = ::mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            ::close(fd);
+            if (memory == MAP_FAILED) return false;
+            Region *region = static_cast<Region *>(memory);
+            if (region->magic != Region::MAGIC || region->size != sizeof(T) ||
+                    Region::bytes(region->capacity) > (std::size_t)info.st_size) {
+                ::munmap(memory, info.st_size);
+                return false;
+            }
+            _region = region;
+            _bytes = info.st_size;
+            _seen = _region->head.load(std::memory_order_acquire);
+            return true;
+        }
+
+        /**
+         * Unmap the region.
+         */
+        void close()
+        {
+            if (_region) ::munmap(_region, _bytes);
+            _region = NULL;
+        }
+
+        /**
+         * Get the latest state in place.  The pointer stays valid, but the
+         * state may be overwritten once the publisher has moved on twice;
+         * pass the version to isCurrent() after using it.
+         *
+         * @param version   Set to the version of the state.
+         * @return          The state.
+         */
+        const T *view(unsigned long long &version) const
+        {
+            Model::read();
+            while (true) {
+                unsigned int index = _region->current.load(std::memory_order_acquire);
+                const typename Region::Buffer &buffer = _region->buffers[index];
+                unsigned int sequence = buffer.sequence.load(std::memory_order_acquire);
+                if (sequence & 1) continue;
+                version = ((unsigned long long)sequence << 1) | index;
+                return &buffer.state;
+            }
+        }
+
+        /**
+         * Check that state returned by view() was not overwritten while it
+         * was being used.
+         *
+         * @param version   Version returned by view().
+         * @return          True if what was read is consistent.
+         */
+        bool isCurrent(unsigned long long version) const
+        {
+            std::atomic_thread_fence(std::memory_order_acquire);
+            const typename Region::Buffer &buffer = _region->buffers[version & 1];
+            return buffer.sequence.load(std::memory_order_relaxed) == (unsigned int)(version >> 1);
+        }
+
+        /**
+         * Copy out a consistent state.
+         *
+         * @param state Set to the state.
+         */
+        void get(T &state) const
+        {
+            unsigned long long version;
+            do {
+                std::memcpy(&state, view(version), sizeof(T));
+            } while (!isCurrent(version));
+        }
+
+        /**
+         * Relay notifications published since the last poll to local
+         * observers.
+         *
+         * @return  Number of notifications relayed.
+         */
+        unsigned int poll()
+        {
+            if (!_region) return 0;
+            unsigned long long head = _region->head.load(std::memory_order_acquire);
+            unsigned long long capacity = _region->capacity;
+            if (head - _seen > capacity) {
+                _missed += head - _seen - capacity;
+                _seen = head - capacity;
+            }
+            unsigned int count = 0;
+            while (_seen < head) {
+                const typename Region::Slot &slot = _region->ring()[_seen % capacity];
+                int event = slot.event;
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (slot.number.load(std::memory_order_relaxed) != _seen + 1) {
+                    _missed++;
+                } else {
+                    Model::notify(event);
+                    count++;
+                }
+                _seen++;
+            }
+            return count;
+        }
+
+        /**
+         * Wait for the publisher to send something.
+         *
+         * @param timeout   Milliseconds to wait at most; negative means no
+         *                  limit.
+         */
+        void wait(long timeout)
+        {
+            if (!_region) return;
+            unsigned int wake = _region->wake.load(std::memory_order_acquire);
+            if (_region->head.load(std::memory_order_acquire) != _seen) return;
+            _region->wait(wake, timeout);
+        }
+
+        /**
+         * Get the number of notifications lost by falling too far behind.
+         *
+         * @return  Number of lost notifications.
+         */
+        unsigned long long getMissed() const
+        {
+            return _missed;
+        }
+
+        /**
+         * Relay pending notifications once per cycle of the main loop.
+         */
+        virtual void tick()
+        {
+            poll();
+        }
+
+        virtual long getPollInterval() const
+        {
+            return _interval;
+        }
+
+    private:
+        typedef SharedRegion<T> Region;
+
+        Region *_region;
+        std::size_t _bytes;
+        unsigned long long _seen;
+        unsigned long long _missed;
+        long _interval;
+
+        DISALLOW_COPY_AND_ASSIGN(SharedModel);
+};
+
+}
+
+#endif
@@ -23,16 +23,38 @@
 #ifndef SYD_FRAMEWORK_SIMPLE_SUBJECT_H_
 #define SYD_FRAMEWORK_SIMPLE_SUBJECT_H_
 
+#include <vector>
+#include <unordered_map>
 #include "Subject.h"
+#include "ObserverGroup.h"
+#include "Subscription.h"
+#include "MemoryAccounting.h"
 
 namespace sydmvc {
 
 /**
  * A simple subject is a subject that uses a very simple system for the
  * attaching, detaching, and notifying of observers.
+ *
+ * Each event has its own list of observers, kept sorted by priority;
+ * observers of equal priority are notified in the order they attached.
+ * An observer can stop an event from reaching the rest of the list by
+ * consuming it (see deliver()).
+ *
+ * Observers that are members of an ObserverGroup are notified in runs: a
+ * stretch of the list holding members of the same group with consecutive
+ * indices is handed to the group in one call (see deliverMembers())
+ * instead of one update() per member.  Members attached in index order at
+ * one priority form one run.
+ *
+ * Detaching through a Subscription is O(1): the observer's slot is marked
+ * dead and its list entries are purged later, in bulk.  Observers attached
+ * or detached while a notification is in progress take effect once it
+ * completes, so observers may attach and detach freely from inside
+ * update().
  */
 template <class S, class O>
-class SimpleSubject: public Subject<O>
+class SimpleSubject: public Subject<O>, public Unsubscriber
 {
     public:
         /**
@@ -40,10 +62,60 @@ class SimpleSubject: public Subject<O>
          *
          * @param observer  Observer to attach.
          * @param list      Notification list associated with the observer.
+         * @param priority  Observers with higher priorities are notified
+         *                  first.
          */
-        virtual void attach(O * const observer, const typename Subject<O>::NotificationList &list)
+        virtual void attach(O * const observer, const typename Subject<O>::NotificationList &list,
+                int priority = 0)
         {
-            _observers[observer] = list;
+            subscribe(observer, list, priority).release();
+        }
+
+        /**
+         * Attach an observer and get a handle that detaches it.  Attaching
+         * an observer again replaces its notification list and priority.
+         *
+         * @param observer  Observer to attach.
+         * @param list      Notification list associated with the observer.
+         * @param priority  Observers with higher priorities are notified
+         *                  first.
+         * @return          Handle to the subscription.
+         */
+        Subscription subscribe(O * const observer, const typename Subject<O>::NotificationList &list,
+                int priority = 0)
+        {
+            unsigned int index;
+            typename ObserverIndex::iterator iter = _index.find(observer);
+            if (iter != _index.end()) {
+                index = iter->second;
+                _stale += _slots[index].entries;
+                _slots[index].entries = 0;
+                _slots[index].version++;
+            } else if (_free.empty()) {
+                index = _slots.size();
+                _slots.push_back(Slot());
+            } else {
+                index = _free.back();
+                _free.pop_back();
+            }
+            Slot &slot = _slots[index];
+            slot.observer = observer;
+            GroupMember *member = dynamic_cast<GroupMember *>(observer);
+            slot.group = member ? member->getGroup() : NULL;
+            slot.member = member ? member->getIndex() : 0;
+            _index[observer] = index;
+            for (typename Subject<O>::NotificationList::const_iterator event = list.begin();
+                    event != list.end();
+                    event++) {
+                Entry entry = { index, slot.version, priority, *event };
+                if (_dispatching) {
+                    _pending.push_back(entry);
+                } else {
+                    insert(entry);
+                }
+                slot.entries++;
+            }
+            return Subscription(this, index, slot.serial);
         }
 
         /**
@@ -53,40 +125,214 @@ class SimpleSubject: public Subject<O>
          */
         virtual void detach(O * const observer)
         {
-            typename ObserverList::iterator iter = _observers.find(observer);
-            if (iter != _observers.end()) {
-                _observers.erase(iter);
+            typename ObserverIndex::iterator iter = _index.find(observer);
+            if (iter != _index.end()) {
+                remove(iter->second);
+            }
+        }
+
+        virtual void unsubscribe(unsigned int index, unsigned int serial)
+        {
+            if (index < _slots.size() && _slots[index].serial == serial && _slots[index].observer) {
+                remove(index);
             }
         }
 
     protected:
 
         /**
-         * Notify all observers who are subscribed for the event.
+         * Notify observers who are subscribed for the event, in priority
+         * order, until one of them consumes it.
          *
          * @param event Event type to notify observers of.
          */
         virtual void notify(int event)
         {
-            for (typename ObserverList::iterator iter = _observers.begin();
-                    iter != _observers.end();
-                    iter++) {
-                for (typename Subject<O>::NotificationList::iterator innerIter = iter->second.begin();
-                        innerIter != iter->second.end();
-                        innerIter++) {
-                    if ((*innerIter) == event) {
-                        iter->first->update(event);
-                    }
+            typename EventIndex::iterator iter = _events.find(event);
+            if (iter == _events.end()) return;
+            _dispatching++;
+            EntryList &entries = iter->second;
+            unsigned int i = 0;
+            while (i < entries.size()) {
+                const Slot &slot = _slots[entries[i].slot];
+                if (slot.version != entries[i].version || !slot.observer) {
+                    i++;
+                    continue;
+                }
+                if (!slot.group) {
+                    i++;
+                    if (deliver(slot.observer, event)) break;
+                    continue;
                 }
+                ObserverGroup *group = slot.group;
+                std::size_t first = slot.member;
+                std::size_t count = 1;
+                for (i++; i < entries.size(); i++) {
+                    const Slot &next = _slots[entries[i].slot];
+                    if (next.version != entries[i].version || !next.observer) continue;
+                    if (next.group != group || next.member != first + count) break;
+                    count++;
+                }
+                if (deliverMembers(group, event, first, count)) break;
             }
+            if (--_dispatching == 0) compact();
+        }
+
+        /**
+         * Deliver an event to an observer.  Subjects whose observers can
+         * consume events override this.
+         *
+         * @param observer  Observer to deliver to.
+         * @param event     Event type.
+         * @return          True if the event was consumed and should not
+         *                  reach observers further down the list.
+         */
+        virtual bool deliver(O * const observer, int event)
+        {
+            observer->update(event);
+            return false;
         }
 
-        SimpleSubject() {}
+        /**
+         * Deliver an event to a run of group members.
+         *
+         * @param group     Group the members belong to.
+         * @param event     Event type.
+         * @param first     Index of the first member.
+         * @param count     Number of members.
+         * @return          True if the event was consumed and should not
+         *                  reach observers further down the list.
+         */
+        virtual bool deliverMembers(ObserverGroup * const group, int event, std::size_t first,
+                std::size_t count)
+        {
+            group->updateMembers(event, first, count);
+            return false;
+        }
+
+        SimpleSubject():_dispatching(0),_stale(0),_live(0) {}
         virtual ~SimpleSubject() {}
 
     private:
-        typedef std::map<O*, typename Subject<O>::NotificationList> ObserverList;
-        ObserverList _observers;
+        struct Slot
+        {
+            Slot():observer(NULL),group(NULL),member(0),serial(0),version(0),entries(0) {}
+            O *observer;
+            ObserverGroup *group;
+            unsigned int member;
+            unsigned int serial;
+            unsigned int version;
+            unsigned int entries;
+        };
+
+        struct Entry
+        {
+            unsigned int slot;
+            unsigned int version;
+            int priority;
+            int event;
+        };
+
+        typedef std::vector<Entry, AccountedAllocator<Entry, MEMORY_NOTIFICATIONS> > EntryList;
+        typedef std::vector<unsigned int, AccountedAllocator<unsigned int, MEMORY_OBSERVERS> > SlotList;
+
+        /**
+         * Put an entry in its event's list, after those of higher or equal
+         * priority.
+         */
+        void insert(const Entry &entry)
+        {
+            EntryList &entries = _events[entry.event];
+            unsigned int low = 0;
+            unsigned int high = entries.size();
+            while (low < high) {
+                unsigned int middle = (low + high) / 2;
+                if (entries[middle].priority >= entry.priority) {
+                    low = middle + 1;
+                } else {
+                    high = middle;
+                }
+            }
+            entries.insert(entries.begin() + low, entry);
+            _live++;
+        }
+
+        /**
+         * Detach the observer in a slot.  Its entries go stale and the slot
+         * is reclaimed straight away, or after the notification in
+         * progress.
+         */
+        void remove(unsigned int index)
+        {
+            Slot &slot = _slots[index];
+            _index.erase(slot.observer);
+            slot.observer = NULL;
+            slot.group = NULL;
+            slot.serial++;
+            slot.version++;
+            _stale += slot.entries;
+            slot.entries = 0;
+            if (_dispatching) {
+                _dead.push_back(index);
+            } else {
+                _free.push_back(index);
+                compact();
+            }
+        }
+
+        /**
+         * Apply what was deferred during a notification, and purge stale
+         * entries once they make up half of all entries.
+         */
+        void compact()
+        {
+            for (typename SlotList::iterator iter = _dead.begin();
+                    iter != _dead.end();
+                    iter++) {
+                _free.push_back(*iter);
+            }
+            _dead.clear();
+            for (typename EntryList::iterator iter = _pending.begin();
+                    iter != _pending.end();
+                    iter++) {
+                if (_slots[iter->slot].version == iter->version) {
+                    insert(*iter);
+                } else {
+                    _stale--;
+                }
+            }
+            _pending.clear();
+            if (_stale * 2 > _live) {
+                for (typename EventIndex::iterator iter = _events.begin();
+                        iter != _events.end();
+                        iter++) {
+                    EntryList &entries = iter->second;
+                    unsigned int kept = 0;
+                    for (unsigned int i = 0; i < entries.size(); i++) {
+                        if (_slots[entries[i].slot].version == entries[i].version) {
+                            entries[kept++] = entries[i];
+                        }
+                    }
+                    entries.resize(kept);
+                }
+                _live -= _stale;
+                _stale = 0;
+            }
+        }
+
+        typedef std::unordered_map<O*, unsigned int, std::hash<O*>, std::equal_to<O*>,
+                AccountedAllocator<std::pair<O* const, unsigned int>, MEMORY_OBSERVERS> > ObserverIndex;
+        typedef std::unordered_map<int, EntryList, std::hash<int>, std::equal_to<int>,
+                AccountedAllocator<std::pair<const int, EntryList>, MEMORY_NOTIFICATIONS> > EventIndex;
+        std::vector<Slot, AccountedAllocator<Slot, MEMORY_OBSERVERS> > _slots;
+        SlotList _free;
+        SlotList _dead;
+        EntryList _pending;
+        ObserverIndex _index;
+        EventIndex _events;
+        unsigned int _dispatching;
+        unsigned int _stale;
+        unsigned int _live;
         DISALLOW_COPY_AND_ASSIGN(SimpleSubject);
 };
 
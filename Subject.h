@@ -42,8 +42,10 @@ class Subject
          *
          * @param observer  Observer to attach.
          * @param nl        Notification list associated with observer.
+         * @param priority  Observers with higher priorities are notified
+         *                  first.
          */
-        virtual void attach(O * const observer, const NotificationList &nl) = 0;
+        virtual void attach(O * const observer, const NotificationList &nl, int priority = 0) = 0;
 
         /**
          * Detach an observer.
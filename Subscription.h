@@ -0,0 +1,131 @@
+/**
+ * Copyright (c) 2008 Christopher Allen Ogden
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef SYD_FRAMEWORK_SUBSCRIPTION_H_
+#define SYD_FRAMEWORK_SUBSCRIPTION_H_
+
+#include <cstddef>
+#include "macros.h"
+
+namespace sydmvc {
+
+/**
+ * Something that hands out subscriptions and can cancel them.
+ */
+class Unsubscriber
+{
+    public:
+        /**
+         * Cancel a subscription.  Stale subscriptions are ignored.
+         *
+         * @param index     Slot of the subscription.
+         * @param serial    Serial number of the subscription in its slot.
+         */
+        virtual void unsubscribe(unsigned int index, unsigned int serial) = 0;
+
+    protected:
+        Unsubscriber() {}
+        ~Unsubscriber() {}
+
+    private:
+        DISALLOW_COPY_AND_ASSIGN(Unsubscriber);
+};
+
+/**
+ * Handle to a subscription.  Cancelling it is O(1), and the subscription
+ * is cancelled when the handle is destroyed, unless it has been released.
+ * A handle must not outlive what it subscribes to.  Handles can be moved
+ * but not copied.
+ */
+class Subscription
+{
+    public:
+        Subscription():_owner(NULL),_index(0),_serial(0) {}
+
+        Subscription(Unsubscriber * const owner, unsigned int index, unsigned int serial)
+            :_owner(owner),_index(index),_serial(serial) {}
+
+        Subscription(Subscription &&other)
+            :_owner(other._owner),_index(other._index),_serial(other._serial)
+        {
+            other._owner = NULL;
+        }
+
+        Subscription &operator=(Subscription &&other)
+        {
+            if (this != &other) {
+                cancel();
+                _owner = other._owner;
+                _index = other._index;
+                _serial = other._serial;
+                other._owner = NULL;
+            }
+            return *this;
+        }
+
+        /**
+         * Destructor.  Cancels the subscription.
+         */
+        ~Subscription()
+        {
+            cancel();
+        }
+
+        /**
+         * Cancel the subscription now.
+         */
+        void cancel()
+        {
+            if (_owner) _owner->unsubscribe(_index, _serial);
+            _owner = NULL;
+        }
+
+        /**
+         * Let go of the subscription without cancelling it.
+         */
+        void release()
+        {
+            _owner = NULL;
+        }
+
+        /**
+         * Check whether the handle still refers to a subscription.
+         *
+         * @return  True unless cancelled, released or empty.
+         */
+        bool active() const
+        {
+            return _owner != NULL;
+        }
+
+    private:
+        Unsubscriber *_owner;
+        unsigned int _index;
+        unsigned int _serial;
+
+        Subscription(const Subscription &);
+        void operator=(const Subscription &);
+};
+
+}
+
+#endif
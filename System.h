@@ -43,11 +43,41 @@ class System: public SimpleSubject<System<I>, Controller<I> >, public I
          */
         virtual void handleEvents() {}
 
+        /**
+         * Wait for events and handle them.  Systems that can block on their
+         * queue should override this; by default it just polls.
+         *
+         * @param timeout   Longest time to wait, in ticks.  Negative means
+         *                  there is nothing else to wake up for.
+         */
+        virtual void waitEvents(long timeout)
+        {
+            handleEvents();
+        }
+
+        /**
+         * Interrupt a waitEvents() in progress.  Called from other threads,
+         * so systems that block must make this safe to do.
+         */
+        virtual void wake() {}
+
         virtual ~System() {}
 
     protected:
         System() {}
 
+        /**
+         * Let the controller handle the event, which it may consume.
+         *
+         * @param controller    Controller to deliver to.
+         * @param event         Event type.
+         * @return              True if the event was consumed.
+         */
+        virtual bool deliver(Controller<I> * const controller, int event)
+        {
+            return controller->handle(event);
+        }
+
     private:
         DISALLOW_COPY_AND_ASSIGN(System);
 };
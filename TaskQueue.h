@@ -0,0 +1,158 @@
+/**
+ * Copyright (c) 2008 Christopher Allen Ogden
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef SYD_FRAMEWORK_TASKQUEUE_H_
+#define SYD_FRAMEWORK_TASKQUEUE_H_
+
+#include <map>
+#include <deque>
+#include <chrono>
+#include "Task.h"
+
+namespace sydmvc {
+
+/**
+ * A cooperative task queue with priorities and a per-cycle time budget.
+ * The budget is what is left of the target frame time after the rest of
+ * the cycle, whose cost is tracked as a moving average.  Tasks of the same
+ * priority take turns; higher priorities always go first.  A priority is
+ * only kept while it has tasks.  The queue owns its tasks and deletes them
+ * once they finish.
+ */
+class TaskQueue
+{
+    public:
+        /**
+         * Constructor.
+         *
+         * @param frame     Target time for one cycle, in microseconds.
+         * @param minimum   Smallest budget given to tasks, in microseconds.
+         */
+        TaskQueue(long frame = 16000, long minimum = 1000)
+            :_frame(frame),_minimum(minimum),_cost(0),_size(0)
+        {
+        }
+
+        /**
+         * Destructor.  Deletes any unfinished tasks.
+         */
+        ~TaskQueue()
+        {
+            for (TaskList::iterator iter = _tasks.begin();
+                    iter != _tasks.end();
+                    iter++) {
+                for (std::deque<Task *>::iterator inner = iter->second.begin();
+                        inner != iter->second.end();
+                        inner++) {
+                    delete (*inner);
+                }
+            }
+        }
+
+        /**
+         * Add a task.
+         *
+         * @param task      Task to add.
+         * @param priority  Higher priorities run first.
+         */
+        void add(Task * const task, int priority = 0)
+        {
+            _tasks[priority].push_back(task);
+            _size++;
+        }
+
+        /**
+         * Check whether any tasks are waiting.
+         *
+         * @return  True if there are no tasks.
+         */
+        bool empty() const
+        {
+            return _size == 0;
+        }
+
+        /**
+         * Set the target time for one cycle.
+         *
+         * @param frame     Target time, in microseconds.
+         * @param minimum   Smallest budget given to tasks, in microseconds.
+         */
+        void setFrameTime(long frame, long minimum)
+        {
+            _frame = frame;
+            _minimum = minimum;
+        }
+
+        /**
+         * Get the budget tasks will be given in the next cycle.
+         *
+         * @return  Budget in microseconds.
+         */
+        long getBudget() const
+        {
+            long budget = _frame - _cost;
+            return budget < _minimum ? _minimum : budget;
+        }
+
+        /**
+         * Run task slices until the budget for this cycle is spent.  At
+         * least one slice runs if any task is waiting.
+         *
+         * @param cost  Time the rest of this cycle took, in microseconds,
+         *              or negative if it is not representative (for
+         *              instance, the cycle was spent waiting for events).
+         */
+        void run(long cost)
+        {
+            if (cost >= 0) _cost += (cost - _cost) / 8;
+            if (_size == 0) return;
+            Clock::time_point deadline = Clock::now() + std::chrono::microseconds(getBudget());
+            do {
+                TaskList::iterator iter = --_tasks.end();
+                std::deque<Task *> &queue = iter->second;
+                Task *task = queue.front();
+                queue.pop_front();
+                if (task->step()) {
+                    delete task;
+                    _size--;
+                    if (queue.empty()) _tasks.erase(iter);
+                } else {
+                    queue.push_back(task);
+                }
+            } while (_size > 0 && Clock::now() < deadline);
+        }
+
+    private:
+        typedef std::chrono::steady_clock Clock;
+        typedef std::map<int, std::deque<Task *> > TaskList;
+        TaskList _tasks;
+        long _frame;
+        long _minimum;
+        long _cost;
+        unsigned int _size;
+
+        DISALLOW_COPY_AND_ASSIGN(TaskQueue);
+};
+
+}
+
+#endif
@@ -0,0 +1,193 @@
+/**
+ * Copyright (c) 2008 Christopher Allen Ogden
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef SYD_FRAMEWORK_THREADPOOL_H_
+#define SYD_FRAMEWORK_THREADPOOL_H_
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include "macros.h"
+
+namespace sydmvc {
+
+/**
+ * A batch of independent work items run by a thread pool.
+ */
+class ParallelJob
+{
+    public:
+        /**
+         * Run one item.  Items may run concurrently, in any order.
+         *
+         * @param index Index of the item.
+         */
+        virtual void run(unsigned int index) = 0;
+
+    protected:
+        ParallelJob() {}
+        ~ParallelJob() {}
+
+    private:
+        DISALLOW_COPY_AND_ASSIGN(ParallelJob);
+};
+
+/**
+ * A fixed set of worker threads that run the items of one job at a time.
+ * The calling thread works on the job too and returns once every item is
+ * done and every worker has let go of the job.
+ */
+class ThreadPool
+{
+    public:
+        /**
+         * Constructor.
+         *
+         * @param threads   Number of worker threads besides the caller.
+         */
+        explicit ThreadPool(unsigned int threads)
+            :_job(NULL),_count(0),_generation(0),_active(0),_next(0),_done(0),_stop(false)
+        {
+            for (unsigned int i = 0; i < threads; i++) {
+                _workers.push_back(std::thread(&ThreadPool::main, this));
+            }
+        }
+
+        /**
+         * Destructor.  Stops the workers.
+         */
+        ~ThreadPool()
+        {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _stop = true;
+            }
+            _start.notify_all();
+            for (std::vector<std::thread>::iterator iter = _workers.begin();
+                    iter != _workers.end();
+                    iter++) {
+                iter->join();
+            }
+        }
+
+        /**
+         * Run every item of a job and wait for them to finish.
+         *
+         * @param job   Job to run.
+         * @param count Number of items.
+         */
+        void run(ParallelJob * const job, unsigned int count)
+        {
+            if (count == 0) return;
+            if (_workers.empty() || count == 1) {
+                for (unsigned int i = 0; i < count; i++) {
+                    job->run(i);
+                }
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _job = job;
+                _count = count;
+                _next.store(0);
+                _done.store(0);
+                _generation++;
+            }
+            _start.notify_all();
+            work(job, count);
+            std::unique_lock<std::mutex> lock(_mutex);
+            while (_done.load() < count || _active > 0) {
+                _finish.wait(lock);
+            }
+            _job = NULL;
+        }
+
+        /**
+         * Get the number of worker threads.
+         *
+         * @return  Number of workers.
+         */
+        unsigned int size() const
+        {
+            return _workers.size();
+        }
+
+    private:
+        /**
+         * Body of a worker thread.
+         */
+        void main()
+        {
+            unsigned long seen = 0;
+            std::unique_lock<std::mutex> lock(_mutex);
+            while (true) {
+                while (!_stop && _generation == seen) {
+                    _start.wait(lock);
+                }
+                if (_stop) return;
+                seen = _generation;
+                if (!_job) continue;
+                ParallelJob *job = _job;
+                unsigned int count = _count;
+                _active++;
+                lock.unlock();
+                work(job, count);
+                lock.lock();
+                if (--_active == 0) _finish.notify_one();
+            }
+        }
+
+        /**
+         * Take items until there are none left.
+         */
+        void work(ParallelJob * const job, unsigned int count)
+        {
+            unsigned int index;
+            while ((index = _next.fetch_add(1)) < count) {
+                job->run(index);
+                if (_done.fetch_add(1) + 1 == count) {
+                    std::lock_guard<std::mutex> lock(_mutex);
+                    _finish.notify_one();
+                }
+            }
+        }
+
+        std::vector<std::thread> _workers;
+        ParallelJob *_job;
+        unsigned int _count;
+        unsigned long _generation;
+        unsigned int _active;
+        std::atomic<unsigned int> _next;
+        std::atomic<unsigned int> _done;
+        bool _stop;
+        std::mutex _mutex;
+        std::condition_variable _start;
+        std::condition_variable _finish;
+
+        DISALLOW_COPY_AND_ASSIGN(ThreadPool);
+};
+
+}
+
+#endif
@@ -0,0 +1,311 @@
+/**
+ * Copyright (c) 2008 Christopher Allen Ogden
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef SYD_FRAMEWORK_TIMERWHEEL_H_
+#define SYD_FRAMEWORK_TIMERWHEEL_H_
+
+#include <vector>
+#include "Observer.h"
+
+namespace sydmvc {
+
+/**
+ * Identifies a timer set on a timer wheel.  Ids of timers that have already
+ * fired or been cancelled are simply ignored, as is a default id, which
+ * never names a timer.
+ */
+class TimerId
+{
+    public:
+        TimerId():index(0),serial(0) {}
+        TimerId(unsigned int i, unsigned int s):index(i),serial(s) {}
+
+        unsigned int index;
+        unsigned int serial;
+};
+
+/**
+ * A hierarchical timer wheel.  Pending timers hang off four wheels of 256
+ * slots each, linked through their pool index, so setting and cancelling a
+ * timer is O(1) regardless of how many are pending.  Timers on the outer
+ * wheels are cascaded inward as time advances.  When a timer expires, its
+ * observer is updated with the event it was set with.
+ *
+ * Time is measured in ticks, whatever the owner chooses them to be.
+ */
+class TimerWheel
+{
+    public:
+        /**
+         * Constructor.
+         */
+        TimerWheel():_next(0),_count(0)
+        {
+            for (unsigned int i = 0; i < HEADS; i++) {
+                _heads[i] = NIL;
+            }
+            _free = NIL;
+        }
+
+        /**
+         * Set a timer.
+         *
+         * @param now       Current tick.
+         * @param delay     Ticks from now until the timer expires.
+         * @param observer  Observer to update when the timer expires.
+         * @param event     Event type to update the observer with.
+         * @param period    If non-zero, the timer is re-armed this many
+         *                  ticks after each expiry until cancelled.
+         * @return          Id of the timer.
+         */
+        TimerId set(unsigned long now, unsigned long delay, Observer * const observer,
+                int event, unsigned long period = 0)
+        {
+            if (_count == 0 && _heads[FIRING] == NIL) {
+                _next = now + 1;
+            }
+            unsigned int index = _free;
+            if (index == NIL) {
+                index = _timers.size();
+                _timers.push_back(Timer());
+            } else {
+                _free = _timers[index].next;
+            }
+            Timer &timer = _timers[index];
+            timer.expires = now + delay;
+            timer.period = period;
+            timer.observer = observer;
+            timer.event = event;
+            place(index);
+            _count++;
+            return TimerId(index, timer.serial);
+        }
+
+        /**
+         * Cancel a timer.
+         *
+         * @param id    Id of the timer to cancel.
+         * @return      True if the timer was pending and has been cancelled.
+         */
+        bool cancel(const TimerId &id)
+        {
+            if (id.index >= _timers.size()) return false;
+            Timer &timer = _timers[id.index];
+            if (timer.serial != id.serial || timer.head == NIL) return false;
+            unlink(id.index);
+            release(id.index);
+            _count--;
+            return true;
+        }
+
+        /**
+         * Advance the wheel, firing every timer that expires up to and
+         * including the given tick.  Timers due on the same tick are fired
+         * as one batch.
+         *
+         * @param now   Current tick.
+         */
+        void advance(unsigned long now)
+        {
+            if (_count == 0) {
+                if (now >= _next) _next = now + 1;
+                return;
+            }
+            while (_next <= now && _count > 0) {
+                unsigned int index = _next & MASK;
+                if (index == 0 && cascade(1) == 0 && cascade(2) == 0) {
+                    cascade(3);
+                }
+                _heads[FIRING] = _heads[index];
+                _heads[index] = NIL;
+                for (unsigned int i = _heads[FIRING]; i != NIL; i = _timers[i].next) {
+                    _timers[i].head = FIRING;
+                }
+                _next++;
+                fire();
+            }
+            if (_count == 0 && now >= _next) _next = now + 1;
+        }
+
+        /**
+         * Find the tick by which the owner should next advance the wheel.
+         * This is exact for timers expiring before the innermost wheel
+         * wraps, and otherwise the tick at which the outer wheels cascade.
+         *
+         * @param tick  Set to the next tick of interest.
+         * @return      False if no timers are pending.
+         */
+        bool nextExpiry(unsigned long &tick) const
+        {
+            if (_count == 0) return false;
+            tick = _next;
+            if (_heads[FIRING] != NIL || (tick & MASK) == 0) return true;
+            while ((tick & MASK) != 0 && _heads[tick & MASK] == NIL) {
+                tick++;
+            }
+            return true;
+        }
+
+        /**
+         * Get the number of pending timers.
+         *
+         * @return  Number of pending timers.
+         */
+        unsigned int size() const
+        {
+            return _count;
+        }
+
+    private:
+        enum {
+            BITS = 8,
+            SLOTS = 1 << BITS,
+            MASK = SLOTS - 1,
+            LEVELS = 4,
+            FIRING = LEVELS * SLOTS,
+            HEADS = FIRING + 1
+        };
+        static const unsigned int NIL = ~0u;
+        static const unsigned long MAX_DELAY = 0xffffffffUL;
+
+        struct Timer
+        {
+            Timer():expires(0),period(0),observer(0),event(0),serial(1),
+                    head(NIL),prev(NIL),next(NIL) {}
+            unsigned long expires;
+            unsigned long period;
+            Observer *observer;
+            int event;
+            unsigned int serial;
+            unsigned int head;
+            unsigned int prev;
+            unsigned int next;
+        };
+
+        /**
+         * Put a timer in the slot matching its expiry.  Timers further out
+         * than the wheels reach are parked at the furthest slot and placed
+         * again from there until they are due.
+         */
+        void place(unsigned int index)
+        {
+            Timer &timer = _timers[index];
+            if (timer.expires < _next) timer.expires = _next;
+            unsigned long delta = timer.expires - _next;
+            unsigned int level = 0;
+            while (level < LEVELS - 1 && (delta >> (BITS * (level + 1))) != 0) {
+                level++;
+            }
+            unsigned long at = delta > MAX_DELAY ? _next + MAX_DELAY : timer.expires;
+            unsigned int head = level * SLOTS + ((at >> (BITS * level)) & MASK);
+            timer.head = head;
+            timer.prev = NIL;
+            timer.next = _heads[head];
+            if (timer.next != NIL) _timers[timer.next].prev = index;
+            _heads[head] = index;
+        }
+
+        /**
+         * Take a timer out of whatever slot it is in.
+         */
+        void unlink(unsigned int index)
+        {
+            Timer &timer = _timers[index];
+            if (timer.prev == NIL) {
+                _heads[timer.head] = timer.next;
+            } else {
+                _timers[timer.prev].next = timer.next;
+            }
+            if (timer.next != NIL) _timers[timer.next].prev = timer.prev;
+            timer.head = NIL;
+        }
+
+        /**
+         * Return a timer to the free list.
+         */
+        void release(unsigned int index)
+        {
+            Timer &timer = _timers[index];
+            if (++timer.serial == 0) timer.serial = 1;
+            timer.observer = 0;
+            timer.next = _free;
+            _free = index;
+        }
+
+        /**
+         * Move the timers in the current slot of an outer wheel inward.
+         *
+         * @return  Index of the slot that was cascaded.
+         */
+        unsigned int cascade(unsigned int level)
+        {
+            unsigned int index = (_next >> (BITS * level)) & MASK;
+            unsigned int head = level * SLOTS + index;
+            unsigned int i = _heads[head];
+            _heads[head] = NIL;
+            while (i != NIL) {
+                unsigned int next = _timers[i].next;
+                place(i);
+                i = next;
+            }
+            return index;
+        }
+
+        /**
+         * Fire the batch of timers on the firing list.  Observers may set or
+         * cancel timers, including ones still waiting in the batch.
+         */
+        void fire()
+        {
+            while (_heads[FIRING] != NIL) {
+                unsigned int index = _heads[FIRING];
+                unlink(index);
+                Timer &timer = _timers[index];
+                if (timer.expires >= _next) {
+                    place(index);
+                    continue;
+                }
+                Observer *observer = timer.observer;
+                int event = timer.event;
+                if (timer.period) {
+                    timer.expires += timer.period;
+                    place(index);
+                } else {
+                    release(index);
+                    _count--;
+                }
+                observer->update(event);
+            }
+        }
+
+        unsigned long _next;
+        unsigned int _count;
+        unsigned int _free;
+        unsigned int _heads[HEADS];
+        std::vector<Timer> _timers;
+
+        DISALLOW_COPY_AND_ASSIGN(TimerWheel);
+};
+
+}
+
+#endif
@@ -0,0 +1,160 @@
+/**
+ * Copyright (c) 2008 Christopher Allen Ogden
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef SYD_FRAMEWORK_VERSIONED_H_
+#define SYD_FRAMEWORK_VERSIONED_H_
+
+#include <memory>
+#include <atomic>
+#include "macros.h"
+
+namespace sydmvc {
+
+/**
+ * An immutable, versioned view of some state.  Snapshots are cheap to copy
+ * and stay valid for as long as they are held, whatever happens to the
+ * state afterwards.
+ */
+template <class T>
+class Snapshot
+{
+    public:
+        Snapshot() {}
+
+        /**
+         * Get the state.
+         *
+         * @return  State as of this snapshot.
+         */
+        const T &get() const
+        {
+            return _version->value;
+        }
+
+        const T *operator->() const
+        {
+            return &_version->value;
+        }
+
+        /**
+         * Get the version number.  Later snapshots have higher numbers.
+         *
+         * @return  Version number.
+         */
+        unsigned long getVersion() const
+        {
+            return _version->number;
+        }
+
+    private:
+        template <class U> friend class Versioned;
+
+        struct Version
+        {
+            Version(const T &v, unsigned long n):value(v),number(n) {}
+            T value;
+            unsigned long number;
+        };
+
+        explicit Snapshot(const std::shared_ptr<const Version> &version):_version(version) {}
+
+        std::shared_ptr<const Version> _version;
+};
+
+/**
+ * Holds state that one thread writes and any thread may snapshot.  Meant to
+ * wrap a persistent structure such as PersistentVector, so each write only
+ * copies the nodes it touches and versions share everything else.  Taking
+ * a snapshot is O(1) and never waits for the writer.
+ */
+template <class T>
+class Versioned
+{
+    public:
+        /**
+         * Constructor.
+         *
+         * @param initial   Initial state, published as version 0.
+         */
+        explicit Versioned(const T &initial = T())
+            :_current(std::make_shared<const Version>(initial, 0)),_published(_current)
+        {
+        }
+
+        /**
+         * Get the current state.  Writer thread only.
+         *
+         * @return  Current state.
+         */
+        const T &get() const
+        {
+            return _current->value;
+        }
+
+        /**
+         * Replace the state and publish it as a new version.  Writer thread
+         * only.
+         *
+         * @param value New state.
+         * @return      New version number.
+         */
+        unsigned long set(const T &value)
+        {
+            unsigned long number = _current->number + 1;
+            std::shared_ptr<const Version> next = std::make_shared<const Version>(value, number);
+            std::atomic_store(&_published, next);
+            _current = next;
+            return number;
+        }
+
+        /**
+         * Take a snapshot of the latest published state.  Any thread.
+         *
+         * @return  Snapshot.
+         */
+        Snapshot<T> snapshot() const
+        {
+            return Snapshot<T>(std::atomic_load(&_published));
+        }
+
+        /**
+         * Get the current version number.  Writer thread only.
+         *
+         * @return  Version number.
+         */
+        unsigned long getVersion() const
+        {
+            return _current->number;
+        }
+
+    private:
+        typedef typename Snapshot<T>::Version Version;
+
+        std::shared_ptr<const Version> _current;
+        std::shared_ptr<const Version> _published;
+
+        DISALLOW_COPY_AND_ASSIGN(Versioned);
+};
+
+}
+
+#endif
@@ -24,13 +24,101 @@
 #define SYD_FRAMEWORK_VIEWCOMPOSITE_H_
 
 #include <vector>
-#include <algorithm>
 #include "ViewObject.h"
 
 namespace sydmvc {
 
+template <class I> class ViewComposite;
+
+/**
+ * Handle to a child of a ViewComposite.  Destroying the handle removes the
+ * child from its parent in O(1) and deletes it, unless the handle has been
+ * released.  A handle must not outlive the parent.
+ */
+template <class I>
+class ChildHandle
+{
+    public:
+        ChildHandle():_parent(NULL),_child(NULL) {}
+
+        ChildHandle(ViewComposite<I> * const parent, ViewObject<I> * const child)
+            :_parent(parent),_child(child) {}
+
+        ChildHandle(ChildHandle &&other):_parent(other._parent),_child(other._child)
+        {
+            other._parent = NULL;
+        }
+
+        ChildHandle &operator=(ChildHandle &&other)
+        {
+            if (this != &other) {
+                reset();
+                _parent = other._parent;
+                _child = other._child;
+                other._parent = NULL;
+            }
+            return *this;
+        }
+
+        /**
+         * Destructor.  Removes and deletes the child.
+         */
+        ~ChildHandle()
+        {
+            reset();
+        }
+
+        /**
+         * Remove and delete the child now.
+         */
+        void reset()
+        {
+            if (_parent) {
+                _parent->removeChild(_child);
+                delete _child;
+            }
+            _parent = NULL;
+        }
+
+        /**
+         * Leave the child with its parent for good.
+         */
+        void release()
+        {
+            _parent = NULL;
+        }
+
+        /**
+         * Get the child.
+         *
+         * @return  The child.
+         */
+        ViewObject<I> *get() const
+        {
+            return _child;
+        }
+
+    private:
+        ViewComposite<I> *_parent;
+        ViewObject<I> *_child;
+
+        ChildHandle(const ChildHandle &);
+        void operator=(const ChildHandle &);
+};
+
 /**
  * ViewComposites may contain other ViewComposites or Views.
+ *
+ * Each child knows its position, so removing a child is O(1).  Removed
+ * children leave a hole that is skipped, and holes are compacted away once
+ * they make up half the children and no traversal is in progress, so
+ * children may be removed from inside update().
+ *
+ * draw() only reads the child list.  Adding and removing children, and
+ * compaction, take the tree lock shared by setTreeLock(), which a
+ * RenderThread holds while drawing, so the tree can change on the logic
+ * thread while it is drawn elsewhere.  Views must therefore not add or
+ * remove children from inside draw().
  */
 template <class I>
 class ViewComposite: public ViewObject<I>
@@ -39,7 +127,7 @@ class ViewComposite: public ViewObject<I>
         /**
          * Empty constructor.
          */
-        ViewComposite() {}
+        ViewComposite():_holes(0),_iterating(0),_lock(NULL) {}
 
         /**
          * Add a child view.
@@ -48,9 +136,24 @@ class ViewComposite: public ViewObject<I>
          */
         virtual void addChild(ViewObject<I> * const view)
         {
+            view->setTreeLock(_lock);
+            std::unique_lock<std::mutex> lock = guard();
+            view->_position = _children.size();
             _children.push_back(view);
         }
 
+        /**
+         * Add a child view and get a handle that removes it.
+         *
+         * @param view  View or ViewComposite to add.
+         * @return      Handle to the child.
+         */
+        ChildHandle<I> adoptChild(ViewObject<I> * const view)
+        {
+            addChild(view);
+            return ChildHandle<I>(this, view);
+        }
+
         /**
          * Remove a child.
          *
@@ -58,9 +161,20 @@ class ViewComposite: public ViewObject<I>
          */
         virtual void removeChild(ViewObject<I> * const view)
         {
-            typename ViewChildren::iterator iter = find(_children.begin(), _children.end(), view);
-            if (iter != _children.end()) {
-                _children.erase(iter);
+            unsigned int position = view->_position;
+            if (position >= _children.size() || _children[position] != view) return;
+            std::unique_lock<std::mutex> lock = guard();
+            _children[position] = NULL;
+            _holes++;
+            compact();
+        }
+
+        virtual void setTreeLock(std::mutex * const lock)
+        {
+            if (lock == _lock) return;
+            _lock = lock;
+            for (unsigned int i = 0; i < _children.size(); i++) {
+                if (_children[i]) _children[i]->setTreeLock(lock);
             }
         }
 
@@ -71,10 +185,8 @@ class ViewComposite: public ViewObject<I>
          */
         virtual void draw(System<I> * const sys) const
         {
-            for (typename ViewChildren::const_iterator iter = _children.begin();
-                    iter != _children.end();
-                    iter++) {
-                (*iter)->draw(sys);
+            for (unsigned int i = 0; i < _children.size(); i++) {
+                if (_children[i]) _children[i]->draw(sys);
             }
         }
         
@@ -85,10 +197,8 @@ class ViewComposite: public ViewObject<I>
          */
         void setFacade(Facade<I> * const facade)
         {
-            for (typename ViewChildren::iterator iter = _children.begin();
-                    iter != _children.end();
-                    iter++) {
-                (*iter)->setFacade(facade);
+            for (unsigned int i = 0; i < _children.size(); i++) {
+                if (_children[i]) _children[i]->setFacade(facade);
             }
         }
 
@@ -100,7 +210,7 @@ class ViewComposite: public ViewObject<I>
             for (typename ViewChildren::iterator iter = _children.begin();
                     iter != _children.end();
                     iter++) {
-                delete (*iter);
+                if (*iter) delete (*iter);
             }
         }
 
@@ -111,10 +221,14 @@ class ViewComposite: public ViewObject<I>
          */
         virtual void update(int event)
         {
-            for (typename ViewChildren::iterator iter = _children.begin();
-                    iter != _children.end();
-                    iter++) {
-                (*iter)->update(event);
+            _iterating++;
+            for (unsigned int i = 0; i < _children.size(); i++) {
+                if (_children[i]) _children[i]->update(event);
+            }
+            _iterating--;
+            if (_holes) {
+                std::unique_lock<std::mutex> lock = guard();
+                compact();
             }
         }
 
@@ -123,15 +237,118 @@ class ViewComposite: public ViewObject<I>
          */
         virtual void attach()
         {
+            _iterating++;
+            for (unsigned int i = 0; i < _children.size(); i++) {
+                if (_children[i]) _children[i]->attach();
+            }
+            _iterating--;
+            if (_holes) {
+                std::unique_lock<std::mutex> lock = guard();
+                compact();
+            }
+        }
+
+        /**
+         * Save the children's state, in order.
+         *
+         * @param image Writer positioned at the view's state.
+         */
+        virtual void save(ImageWriter &image) const
+        {
+            image.write((unsigned int)(_children.size() - _holes));
+            for (typename ViewChildren::const_iterator iter = _children.begin();
+                    iter != _children.end();
+                    iter++) {
+                if (*iter) (*iter)->save(image);
+            }
+        }
+
+        /**
+         * Restore the children's state.  Fails if the tree no longer has
+         * the shape it was saved with.
+         *
+         * @param image Reader positioned at the view's state.
+         * @return      True if every child was restored.
+         */
+        virtual bool restore(ImageReader &image)
+        {
+            unsigned int count;
+            if (!image.read(count) || count != _children.size() - _holes) return false;
             for (typename ViewChildren::iterator iter = _children.begin();
                     iter != _children.end();
                     iter++) {
-                (*iter)->attach();
+                if (*iter && !(*iter)->restore(image)) return false;
+            }
+            return true;
+        }
+
+        /**
+         * Get the memory used by this view, its children and their list.
+         *
+         * @return  Bytes used, if memory accounting is on.
+         */
+        virtual std::size_t footprint() const
+        {
+            std::size_t bytes = ViewObject<I>::footprint();
+            if (MemoryAccounting::enabled()) bytes += _children.capacity() * sizeof(ViewObject<I> *);
+            for (typename ViewChildren::const_iterator iter = _children.begin();
+                    iter != _children.end();
+                    iter++) {
+                if (*iter) bytes += (*iter)->footprint();
+            }
+            return bytes;
+        }
+
+        /**
+         * Detach method.
+         */
+        virtual void detach()
+        {
+            _iterating++;
+            for (unsigned int i = 0; i < _children.size(); i++) {
+                if (_children[i]) _children[i]->detach();
+            }
+            _iterating--;
+            if (_holes) {
+                std::unique_lock<std::mutex> lock = guard();
+                compact();
             }
         }
     private:
-        typedef std::vector<ViewObject<I> *> ViewChildren;
+        typedef std::vector<ViewObject<I> *,
+                AccountedAllocator<ViewObject<I> *, MEMORY_VIEW_TREES> > ViewChildren;
+
+        /**
+         * Take the tree lock, if there is one.
+         */
+        std::unique_lock<std::mutex> guard()
+        {
+            if (!_lock) return std::unique_lock<std::mutex>();
+            return std::unique_lock<std::mutex>(*_lock);
+        }
+
+        /**
+         * Squeeze out the holes left by removed children, once there are
+         * enough of them and nothing is walking the children.  The tree
+         * lock must be held.
+         */
+        void compact()
+        {
+            if (_iterating || _holes * 2 <= _children.size()) return;
+            unsigned int kept = 0;
+            for (unsigned int i = 0; i < _children.size(); i++) {
+                if (!_children[i]) continue;
+                _children[i]->_position = kept;
+                _children[kept++] = _children[i];
+            }
+            _children.resize(kept);
+            _holes = 0;
+        }
+
         ViewChildren _children;
+        unsigned int _holes;
+        unsigned int _iterating;
+        std::mutex *_lock;
         DISALLOW_COPY_AND_ASSIGN(ViewComposite);
 };
 
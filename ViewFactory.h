@@ -0,0 +1,102 @@
+/**
+ * Copyright (c) 2008 Christopher Allen Ogden
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef SYD_FRAMEWORK_VIEWFACTORY_H_
+#define SYD_FRAMEWORK_VIEWFACTORY_H_
+
+#include "ViewObject.h"
+
+namespace sydmvc {
+
+/**
+ * Creates a view on demand.  Registering a factory instead of a view lets
+ * the facade put off building and attaching the view until it is first
+ * needed.
+ */
+template <class I>
+class ViewFactory
+{
+    public:
+        /**
+         * Create the view.
+         *
+         * @return  A new view, owned by the caller.
+         */
+        virtual ViewObject<I> *create() = 0;
+
+        /**
+         * Check whether the facade may destroy idle views made by this
+         * factory.  Only say so if the views undo everything attach() did,
+         * including subscriptions to models, in ViewObject::detach().
+         *
+         * @return  True if views may be evicted.
+         */
+        virtual bool isEvictable() const
+        {
+            return false;
+        }
+
+        /**
+         * Empty destructor.
+         */
+        virtual ~ViewFactory() {}
+
+    protected:
+        ViewFactory() {}
+
+    private:
+        DISALLOW_COPY_AND_ASSIGN(ViewFactory);
+};
+
+/**
+ * Factory for views that are default constructible.
+ */
+template <class I, class V>
+class SimpleViewFactory: public ViewFactory<I>
+{
+    public:
+        /**
+         * Constructor.
+         *
+         * @param evictable True if idle views may be destroyed.
+         */
+        explicit SimpleViewFactory(bool evictable = false):_evictable(evictable) {}
+
+        virtual ViewObject<I> *create()
+        {
+            return new V();
+        }
+
+        virtual bool isEvictable() const
+        {
+            return _evictable;
+        }
+
+    private:
+        bool _evictable;
+
+        DISALLOW_COPY_AND_ASSIGN(SimpleViewFactory);
+};
+
+}
+
+#endif
@@ -23,7 +23,10 @@
 #ifndef SYD_FRAMEWORK_VIEWOBJECT_H_
 #define SYD_FRAMEWORK_VIEWOBJECT_H_
 
+#include <mutex>
 #include "ModelObserver.h"
+#include "Image.h"
+#include "MemoryAccounting.h"
 
 namespace sydmvc {
 
@@ -34,7 +37,7 @@ template <class I> class Facade;
  * ViewObjects represent either Views or ViewComposites.
  */
 template <class I>
-class ViewObject: public ModelObserver
+class ViewObject: public ModelObserver, public AccountedObject<MEMORY_VIEWS>
 {
     public:
         /**
@@ -65,6 +68,15 @@ class ViewObject: public ModelObserver
          */
         virtual void removeChild(ViewObject * const view) {}
 
+        /**
+         * Share the lock that guards the shape of the view tree.  The
+         * facade sets it on the views it owns; composites pass it on to
+         * their children and hold it while changing their child lists.
+         *
+         * @param lock  Lock to share, or NULL for none.
+         */
+        virtual void setTreeLock(std::mutex * const lock) {}
+
         /**
          * Empty virtual destructor.
          */
@@ -81,10 +93,53 @@ class ViewObject: public ModelObserver
          * Do any kind of model attachment needed.
          */
         virtual void attach() {}
+
+        /**
+         * Get the memory used by this view.  Only meaningful for views
+         * allocated with new while memory accounting is on.
+         *
+         * @return  Bytes used, or 0 if not accounted.
+         */
+        virtual std::size_t footprint() const
+        {
+            return accountedSize();
+        }
+
+        /**
+         * Undo whatever attach() did.  Views that may be evicted must
+         * detach from every subject they subscribed to here.
+         */
+        virtual void detach() {}
+
+        /**
+         * Write the view's state to an image.
+         *
+         * @param image Writer positioned at the view's state.
+         */
+        virtual void save(ImageWriter &image) const {}
+
+        /**
+         * Restore the view's state from an image written by save().
+         *
+         * @param image Reader positioned at the view's state.
+         * @return      False if the image does not hold what save() writes.
+         *              Views with nothing to restore succeed.
+         */
+        virtual bool restore(ImageReader &image)
+        {
+            return true;
+        }
     protected:
-        ViewObject() {}
+        ViewObject():_position(0) {}
 
     private:
+        template <class J> friend class ViewComposite;
+
+        /**
+         * Position among the children of the composite holding this view.
+         */
+        unsigned int _position;
+
         DISALLOW_COPY_AND_ASSIGN(ViewObject);
 };
 
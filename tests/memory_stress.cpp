@@ -0,0 +1,157 @@
+/**
+ * Copyright (c) 2008 Christopher Allen Ogden
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ * Memory stress harness.  Builds a view tree of a million views and a model
+ * with a hundred thousand observers, then checks what the framework spends
+ * per object against fixed budgets.  Exits with 1 if any budget is
+ * exceeded.
+ *
+ * Build and run from this directory:
+ *
+ *     g++ -std=c++11 -O2 -DSYD_FRAMEWORK_ACCOUNTING -I.. memory_stress.cpp \
+ *         -o memory_stress -pthread && ./memory_stress
+ */
+
+#include <cstdio>
+#include <vector>
+#include "Facade.h"
+#include "View.h"
+#include "ViewComposite.h"
+
+using namespace sydmvc;
+
+namespace {
+
+const unsigned int VIEWS = 1000000;
+const unsigned int OBSERVERS = 100000;
+
+/**
+ * Budgets, in bytes per object.
+ */
+const std::size_t VIEW_OBJECT_BUDGET = 48;
+const std::size_t VIEW_TREE_BUDGET = 16;
+const std::size_t OBSERVER_BUDGET = 128;
+
+struct Interface {};
+
+class StressSystem: public System<Interface> {};
+
+class StressFacade: public Facade<Interface>
+{
+    protected:
+        virtual void initSystem()
+        {
+            setSystem(new StressSystem());
+        }
+};
+
+/**
+ * A view with no state of its own, so everything it costs is framework
+ * overhead.
+ */
+class EmptyView: public View<Interface> {};
+
+/**
+ * Check one budget and print the result.
+ *
+ * @param what      What is being measured.
+ * @param bytes     Bytes spent.
+ * @param count     Number of objects.
+ * @param budget    Bytes allowed per object.
+ * @return          True if within budget.
+ */
+bool check(const char * const what, std::size_t bytes, std::size_t count, std::size_t budget)
+{
+    double each = (double)bytes / count;
+    bool ok = each <= budget;
+    std::printf("%-24s %10.1f bytes each, budget %lu: %s\n", what, each,
+            (unsigned long)budget, ok ? "ok" : "EXCEEDED");
+    return ok;
+}
+
+}
+
+int main()
+{
+    if (!MemoryAccounting::enabled()) {
+        std::fprintf(stderr, "memory_stress: build with -DSYD_FRAMEWORK_ACCOUNTING\n");
+        return 1;
+    }
+    bool ok = true;
+
+    StressFacade *facade = new StressFacade();
+    facade->init();
+
+    MemoryUsage viewsBefore = MemoryAccounting::usage(MEMORY_VIEWS);
+    MemoryUsage treesBefore = MemoryAccounting::usage(MEMORY_VIEW_TREES);
+    ViewComposite<Interface> *root = new ViewComposite<Interface>();
+    for (unsigned int i = 0; i < VIEWS; i++) {
+        root->addChild(new EmptyView());
+    }
+    facade->attachView(1, root);
+    MemoryUsage views = MemoryAccounting::usage(MEMORY_VIEWS);
+    MemoryUsage trees = MemoryAccounting::usage(MEMORY_VIEW_TREES);
+    ok &= check("view object", views.bytes - viewsBefore.bytes, VIEWS, VIEW_OBJECT_BUDGET);
+    ok &= check("view tree slot", trees.bytes - treesBefore.bytes, VIEWS, VIEW_TREE_BUDGET);
+    ok &= check("view tree footprint", root->footprint(), VIEWS + 1,
+            VIEW_OBJECT_BUDGET + VIEW_TREE_BUDGET);
+
+    Model *model = new Model();
+    facade->attachModel(2, model);
+    MemoryUsage observersBefore = MemoryAccounting::usage(MEMORY_OBSERVERS);
+    MemoryUsage notificationsBefore = MemoryAccounting::usage(MEMORY_NOTIFICATIONS);
+    std::vector<EmptyView *> observers;
+    observers.reserve(OBSERVERS);
+    for (unsigned int i = 0; i < OBSERVERS; i++) {
+        EmptyView *observer = new EmptyView();
+        observers.push_back(observer);
+        model->attach(observer, Model::NotificationList(1, i % 16));
+    }
+    MemoryUsage observersAfter = MemoryAccounting::usage(MEMORY_OBSERVERS);
+    MemoryUsage notifications = MemoryAccounting::usage(MEMORY_NOTIFICATIONS);
+    ok &= check("subscription",
+            observersAfter.bytes - observersBefore.bytes +
+            notifications.bytes - notificationsBefore.bytes,
+            OBSERVERS, OBSERVER_BUDGET);
+
+    facade->reportMemory(stdout);
+
+    for (std::vector<EmptyView *>::iterator iter = observers.begin();
+            iter != observers.end();
+            iter++) {
+        model->detach(*iter);
+        delete (*iter);
+    }
+    delete facade;
+
+    for (int i = 0; i < MEMORY_CATEGORIES; i++) {
+        MemoryUsage left = MemoryAccounting::usage((MemoryCategory)i);
+        if (left.allocations != 0) {
+            std::printf("%s: %lu allocations leaked\n", MemoryAccounting::name((MemoryCategory)i),
+                    (unsigned long)left.allocations);
+            ok = false;
+        }
+    }
+    std::printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,152 @@
+/**
+ * Copyright (c) 2008 Christopher Allen Ogden
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ * Notification benchmark.  Broadcasts events to a hundred thousand
+ * observers, once as separate objects each receiving a virtual update()
+ * and once as the members of an ObserverArray, which the model notifies a
+ * run at a time, and prints the throughput of both.
+ *
+ * Build and run from this directory:
+ *
+ *     g++ -std=c++11 -O2 -I.. notify_bench.cpp -o notify_bench -pthread && ./notify_bench
+ *
+ * Add -march=native to let the batch loop use the widest vector unit.
+ */
+
+#include <cstdio>
+#include <chrono>
+#include <vector>
+#include "Model.h"
+#include "ObserverArray.h"
+
+using namespace sydmvc;
+
+namespace {
+
+const unsigned int OBSERVERS = 100000;
+const unsigned int ROUNDS = 200;
+const int EVENT = 1;
+
+class BroadcastModel: public Model
+{
+    public:
+        void broadcast()
+        {
+            notify(EVENT);
+        }
+};
+
+/**
+ * One observer per object.
+ */
+class SingleObserver: public ModelObserver
+{
+    public:
+        SingleObserver():value(0) {}
+
+        virtual void update(int event)
+        {
+            value = value * 0.5f + event;
+        }
+
+        float value;
+};
+
+/**
+ * The same observers as one array.
+ */
+class BatchObserver: public ObserverArray<ModelObserver, float>
+{
+    protected:
+        virtual void batch(int event, float *begin, std::size_t count)
+        {
+            float amount = (float)event;
+            for (std::size_t i = 0; i < count; i++) {
+                begin[i] = begin[i] * 0.5f + amount;
+            }
+        }
+};
+
+/**
+ * Time a number of broadcasts.
+ *
+ * @param model Model to broadcast from.
+ * @return      Updates delivered per second.
+ */
+double measure(BroadcastModel &model)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < ROUNDS; i++) {
+        model.broadcast();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return (double)OBSERVERS * ROUNDS / seconds;
+}
+
+}
+
+int main()
+{
+    Model::NotificationList events(1, EVENT);
+
+    BroadcastModel single;
+    std::vector<SingleObserver *> observers;
+    for (unsigned int i = 0; i < OBSERVERS; i++) {
+        observers.push_back(new SingleObserver());
+        single.attach(observers.back(), events);
+    }
+
+    BroadcastModel batched;
+    BatchObserver array;
+    std::vector<BatchObserver::Member *> members;
+    array.reserve(OBSERVERS);
+    for (unsigned int i = 0; i < OBSERVERS; i++) {
+        members.push_back(array.add(0));
+        batched.attach(members.back(), events);
+    }
+
+    double virtualRate = measure(single);
+    double batchRate = measure(batched);
+    std::printf("observers %u, broadcasts %u\n", OBSERVERS, ROUNDS);
+    std::printf("virtual update  %10.1f M updates/s\n", virtualRate / 1e6);
+    std::printf("observer array  %10.1f M updates/s (%.1fx)\n", batchRate / 1e6,
+            batchRate / virtualRate);
+
+    bool same = observers[0]->value == array.at(members[0]);
+    for (std::vector<SingleObserver *>::iterator iter = observers.begin();
+            iter != observers.end();
+            iter++) {
+        single.detach(*iter);
+        delete (*iter);
+    }
+    for (std::vector<BatchObserver::Member *>::iterator iter = members.begin();
+            iter != members.end();
+            iter++) {
+        batched.detach(*iter);
+    }
+    if (!same) {
+        std::fprintf(stderr, "notify_bench: results differ\n");
+        return 1;
+    }
+    return 0;
+}